@@ -24,10 +24,13 @@
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/conin.h"
+#include "userprog/conout.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #else
 #include "tests/threads/tests.h"
 #endif
@@ -37,6 +40,12 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#include "vm/swap.h"
+#endif
 
 uint32_t *init_page_dir;
 
@@ -105,6 +114,10 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+#ifdef USERPROG
+  conin_init ();
+  conout_init ();
+#endif
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -113,6 +126,16 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+  shm_init ();
+#endif
+#ifdef USERPROG
+  vdso_init ();
+#endif
+
   printf ("Boot complete.\n");
   run_actions (argv);
   shutdown ();
@@ -221,6 +244,12 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
+      else if (!strcmp (name, "-ll"))
+        lock_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -320,6 +349,10 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit each process's stack to COUNT pages.\n"
+          "  -ll=COUNT          Limit pages locked by mlock() to COUNT.\n"
 #endif
           );
   shutdown_power_off ();
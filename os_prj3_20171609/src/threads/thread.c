@@ -14,6 +14,7 @@
 #include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/vdso.h"
 #endif
 
 #define THREAD_MAGIC 0xcd6abf4b
@@ -94,6 +95,9 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+#ifdef USERPROG
+  vdso_tick ();
+#endif
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 
@@ -342,17 +346,12 @@ init_thread (struct thread *t, const char *name, int priority)
   t->recent_cpu = running_thread()->recent_cpu;
 
 #ifdef USERPROG
-  t->parent = running_thread();
-  sema_init(&(t->sema_exit), 0);
-  sema_init(&(t->sema_load), 0);
-  sema_init(&(t->mem_lock),0);
-  t->endingswitch = 0;
-  t->loadingswitch = 0;
-  t->waitswitch = 0;
-  list_init(&(t->child));
-  list_push_back(&(running_thread()-> child), &(t->child_elem));
-  for(int i = 0; i < 128; i++)
-    t->file[i] = NULL;
+  t->exit_status = -1;
+  fd_table_init (&t->fds);
+#ifdef VM
+  list_init (&t->mappings);
+  list_init (&t->shm);
+#endif
 
 #endif
 }
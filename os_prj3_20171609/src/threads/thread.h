@@ -5,6 +5,16 @@
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"  
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
+#ifdef VM
+#include <hash.h>
+#endif
+
+struct child_status;
+struct hash;
+struct intr_frame;
 
 
 
@@ -39,20 +49,25 @@ struct thread
     uint32_t *pagedir;                  /* Page directory. */
 #endif
 
-    struct thread *parent;
-    struct list_elem child_elem;
-    struct list child;
-    bool loadingswitch;
-    bool endingswitch;
-    bool waitswitch;
     int exit_status;
 	int nice;
 	int recent_cpu;
 
-    struct semaphore sema_exit;
-    struct semaphore sema_load;
-    struct semaphore mem_lock;
-    struct file *file[130];
+#ifdef USERPROG
+    struct child_status *status;        /* Shared with parent, or null. */
+    struct hash *children;              /* Children's statuses, by tid. */
+    struct fd_table fds;                /* Open file descriptors. */
+    struct io_ring *io_ring;            /* Batched system call ring. */
+    struct file *exec_file;             /* Running executable. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct intr_frame *user_if;         /* User context at system call entry. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+    struct list shm;                    /* Attached shared memory segments. */
+#endif
     int64_t wake_up;
     unsigned magic;                     /* Detects stack overflow. */
   };
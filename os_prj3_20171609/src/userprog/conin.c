@@ -0,0 +1,87 @@
+#include "userprog/conin.h"
+#include <debug.h>
+#include <stdint.h>
+#include "devices/input.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffered console input for user processes.
+
+   A kernel thread moves keys from the keyboard and serial input
+   queue into a ring buffer as they arrive, so read() from the
+   console takes whatever has been typed in one go, under a lock
+   of its own, instead of calling input_getc() once per byte with
+   the file system lock held.  A read returns as soon as anything
+   is buffered, and stops after the first newline, so that each
+   read() gets at most one line.  When the ring is full the thread
+   stops taking keys, and the input queue holds on to the rest. */
+
+/* Size of the ring in bytes.  Must be a power of 2. */
+#define CONIN_SIZE 1024
+
+static uint8_t ring[CONIN_SIZE];
+static uint32_t head;                   /* Total bytes received. */
+static uint32_t tail;                   /* Total bytes read. */
+
+static struct lock conin_lock;          /* Protects the above. */
+static struct condition not_empty;      /* Signaled when a key arrives. */
+static struct condition not_full;       /* Signaled when keys are read. */
+
+static thread_func input_thread NO_RETURN;
+
+/* Initializes the console input ring and starts the thread that
+   fills it.  Must be called after thread_start(). */
+void
+conin_init (void)
+{
+  lock_init (&conin_lock);
+  cond_init (&not_empty);
+  cond_init (&not_full);
+  head = tail = 0;
+  thread_create ("conin", PRI_DEFAULT, input_thread, NULL);
+}
+
+/* Reads up to SIZE bytes of console input into kernel BUFFER,
+   stopping after a newline.  If nothing has been typed, waits for
+   a key if BLOCK is true, or returns -1 at once otherwise, so that
+   the caller does not take it for end of file.  Returns the number
+   of bytes read. */
+int
+conin_read (void *buffer, size_t size, bool block)
+{
+  uint8_t *dst = buffer;
+  size_t n = 0;
+
+  lock_acquire (&conin_lock);
+  while (block && head == tail)
+    cond_wait (&not_empty, &conin_lock);
+  while (n < size && tail != head)
+    {
+      uint8_t c = ring[tail++ % CONIN_SIZE];
+
+      dst[n++] = c;
+      if (c == '\n' || c == '\r')
+        break;
+    }
+  if (n > 0)
+    cond_signal (&not_full, &conin_lock);
+  lock_release (&conin_lock);
+  return n > 0 || size == 0 ? (int) n : -1;
+}
+
+/* Moves keys from the input queue into the ring, forever. */
+static void
+input_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      uint8_t c = input_getc ();
+
+      lock_acquire (&conin_lock);
+      while (head - tail == CONIN_SIZE)
+        cond_wait (&not_full, &conin_lock);
+      ring[head++ % CONIN_SIZE] = c;
+      cond_broadcast (&not_empty, &conin_lock);
+      lock_release (&conin_lock);
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef USERPROG_CONIN_H
+#define USERPROG_CONIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void conin_init (void);
+int conin_read (void *buffer, size_t size, bool block);
+
+#endif /* userprog/conin.h */
@@ -0,0 +1,151 @@
+#include "userprog/conout.h"
+#include <console.h>
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffered console output for user processes.
+
+   write() to the console copies into a ring buffer under a lock
+   of its own and returns; a kernel thread drains the ring to the
+   console in the background.  So a process that writes a lot to
+   the console neither holds the file system lock nor waits for
+   the serial port, unless it fills the whole ring.  In that case,
+   and in conout_flush(), the caller writes the ring out itself
+   instead of waiting for the drain thread to be scheduled, and
+   only waits while another thread has a chunk on its way out.
+
+   Kernel messages about a process, such as its exit status, are
+   printed directly, so conout_flush() must be called first to
+   keep them in order with what the process wrote. */
+
+/* Size of the ring in bytes.  Must be a power of 2. */
+#define CONOUT_SIZE 4096
+
+/* Largest chunk written out at once. */
+#define DRAIN_CHUNK 256
+
+static uint8_t ring[CONOUT_SIZE];
+static uint32_t head;                   /* Total bytes written. */
+static uint32_t tail;                   /* Total bytes drained. */
+static bool draining;                   /* A chunk is being written out. */
+
+static struct lock conout_lock;         /* Protects the above. */
+static struct condition not_empty;      /* Signaled when data arrives. */
+static struct condition drained;        /* Signaled when a chunk is out. */
+
+static void drain_chunk (void);
+static thread_func drain_thread NO_RETURN;
+
+/* Initializes the console ring and starts its drain thread.
+   Must be called after thread_start(). */
+void
+conout_init (void)
+{
+  lock_init (&conout_lock);
+  cond_init (&not_empty);
+  cond_init (&drained);
+  head = tail = 0;
+  draining = false;
+  thread_create ("conout", PRI_DEFAULT, drain_thread, NULL);
+}
+
+/* Queues the SIZE bytes in kernel BUFFER for output to the
+   console, writing out the ring to make room as necessary. */
+void
+conout_write (const void *buffer, size_t size)
+{
+  const uint8_t *src = buffer;
+
+  lock_acquire (&conout_lock);
+  while (size > 0)
+    {
+      uint32_t room = CONOUT_SIZE - (head - tail);
+      uint32_t ofs = head % CONOUT_SIZE;
+      size_t n;
+
+      if (room == 0)
+        {
+          if (draining)
+            cond_wait (&drained, &conout_lock);
+          else
+            drain_chunk ();
+          continue;
+        }
+      n = size < room ? size : room;
+      if (n > CONOUT_SIZE - ofs)
+        n = CONOUT_SIZE - ofs;
+      memcpy (ring + ofs, src, n);
+      head += n;
+      src += n;
+      size -= n;
+      cond_signal (&not_empty, &conout_lock);
+    }
+  lock_release (&conout_lock);
+}
+
+/* Writes out everything queued so far and returns once it has
+   reached the console. */
+void
+conout_flush (void)
+{
+  lock_acquire (&conout_lock);
+  while (head != tail || draining)
+    {
+      if (draining)
+        cond_wait (&drained, &conout_lock);
+      else
+        drain_chunk ();
+    }
+  lock_release (&conout_lock);
+}
+
+/* Writes the oldest chunk in the ring, which must not be empty,
+   out to the console.  The caller must hold conout_lock, which is
+   dropped while the chunk goes out, and no other thread may be
+   draining. */
+static void
+drain_chunk (void)
+{
+  char chunk[DRAIN_CHUNK];
+  uint32_t ofs = tail % CONOUT_SIZE;
+  size_t n = head - tail;
+
+  ASSERT (lock_held_by_current_thread (&conout_lock));
+  ASSERT (n > 0 && !draining);
+
+  if (n > CONOUT_SIZE - ofs)
+    n = CONOUT_SIZE - ofs;
+  if (n > DRAIN_CHUNK)
+    n = DRAIN_CHUNK;
+  memcpy (chunk, ring + ofs, n);
+  tail += n;
+  draining = true;
+  lock_release (&conout_lock);
+
+  putbuf (chunk, n);
+
+  lock_acquire (&conout_lock);
+  draining = false;
+  cond_broadcast (&drained, &conout_lock);
+}
+
+/* Writes out the ring whenever it has data and no other thread is
+   already doing so, forever. */
+static void
+drain_thread (void *aux UNUSED)
+{
+  lock_acquire (&conout_lock);
+  for (;;)
+    {
+      if (head == tail)
+        cond_wait (&not_empty, &conout_lock);
+      else if (draining)
+        cond_wait (&drained, &conout_lock);
+      else
+        drain_chunk ();
+    }
+}
@@ -0,0 +1,10 @@
+#ifndef USERPROG_CONOUT_H
+#define USERPROG_CONOUT_H
+
+#include <stddef.h>
+
+void conout_init (void);
+void conout_write (const void *buffer, size_t size);
+void conout_flush (void);
+
+#endif /* userprog/conout.h */
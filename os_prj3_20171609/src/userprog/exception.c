@@ -1,10 +1,15 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include "userprog/conout.h"
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 
 /* Number of page faults processed. */
@@ -87,7 +92,9 @@ kill (struct intr_frame *f)
     {
     case SEL_UCSEG:
       /* User's code segment, so it's a user exception, as we
-         expected.  Kill the user process.  */
+         expected.  Kill the user process, after letting what it
+         wrote to the console go out first.  */
+      conout_flush ();
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
@@ -149,12 +156,49 @@ page_fault (struct intr_frame *f)
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
-  if(!user||is_kernel_vaddr(fault_addr)||not_present){
-    exit(-1);
-  }
+
+#ifdef VM
+  /* Bring in the page from the supplemental page table, whether
+     the process itself or the kernel on its behalf touched it, or
+     grow the stack down to it.  A fault in a system call must use
+     the user ESP saved at entry, since F->esp is then the kernel's;
+     kernel threads, and processes that have not yet made a system
+     call, have no saved ESP and so never grow a stack.  A write to
+     a present page may be to a copy-on-write page shared since
+     fork(). */
+  if (not_present
+      && (page_in (fault_addr, write)
+          || ((user || thread_current ()->user_if != NULL)
+              && page_grow_stack (fault_addr,
+                                  user ? f->esp
+                                       : thread_current ()->user_if->esp))))
+    return;
+  if (!not_present && write && page_write_fault (fault_addr))
+    return;
+#endif
+
+  /* A kernel access to a user address from get_user(),
+     put_user(), or get_user_word() in syscall.c: resume at the
+     address recorded for the faulting instruction and report the
+     failure through EAX.  Any other kernel fault is a kernel bug
+     and goes to kill() below. */
+  if (!user)
+    {
+      void *resume = syscall_fixup (f->eip);
+      if (resume != NULL && is_user_vaddr (fault_addr))
+        {
+          f->eip = (void (*) (void)) resume;
+          f->eax = 0xffffffff;
+          return;
+        }
+    }
+  else if (is_kernel_vaddr (fault_addr) || not_present)
+    exit (-1);
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
+  if (user)
+    conout_flush ();
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -0,0 +1,299 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "userprog/pipe.h"
+
+/* Number of slots in a table when its first descriptor is
+   allocated. */
+#define FD_INIT_CNT 16
+
+static int install (struct fd_table *, const struct fd_entry *);
+static bool copy_entry (struct fd_entry *dst, const struct fd_entry *src);
+static void close_entry (struct fd_entry *);
+static bool grow (struct fd_table *, size_t min_cap);
+
+/* Initializes T as an empty table.  Nothing is allocated until
+   the first descriptor is opened. */
+void
+fd_table_init (struct fd_table *t)
+{
+  t->entries = NULL;
+  t->used = NULL;
+  t->cap = 0;
+  t->nonblock_stdin = false;
+}
+
+/* Closes every file and pipe end open in T and frees T's
+   storage.  Only descriptors that are actually in use are
+   visited. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  if (t->used != NULL)
+    {
+      size_t fd = FD_MIN;
+
+      while ((fd = bitmap_scan (t->used, fd, 1, true)) != BITMAP_ERROR)
+        {
+          close_entry (&t->entries[fd]);
+          fd++;
+        }
+      bitmap_destroy (t->used);
+    }
+  free (t->entries);
+  fd_table_init (t);
+}
+
+/* Makes empty table DST a copy of SRC, with each descriptor open
+   on a new handle to the same file at the same position, or on
+   the same pipe end, for fork().  Returns true if successful,
+   false if memory is exhausted, in which case DST holds the
+   descriptors copied so far.  The caller must hold the file
+   system lock. */
+bool
+fd_table_copy (struct fd_table *dst, const struct fd_table *src)
+{
+  size_t fd = FD_MIN;
+
+  ASSERT (dst->cap == 0);
+
+  dst->nonblock_stdin = src->nonblock_stdin;
+  if (src->used == NULL)
+    return true;
+  if (!grow (dst, src->cap))
+    return false;
+
+  while ((fd = bitmap_scan (src->used, fd, 1, true)) != BITMAP_ERROR)
+    {
+      if (!copy_entry (&dst->entries[fd], &src->entries[fd]))
+        return false;
+      bitmap_mark (dst->used, fd);
+      fd++;
+    }
+  return true;
+}
+
+/* Installs FILE in the lowest free descriptor of T, growing T if
+   necessary, and returns the descriptor.
+   Returns -1 if T is full or memory is exhausted. */
+int
+fd_alloc (struct fd_table *t, struct file *file)
+{
+  struct fd_entry e;
+
+  ASSERT (file != NULL);
+
+  e.file = file;
+  e.pipe = NULL;
+  e.write_end = false;
+  e.nonblock = false;
+  return install (t, &e);
+}
+
+/* Installs the write end of PIPE if WRITE_END is true, or its
+   read end otherwise, in the lowest free descriptor of T, and
+   returns the descriptor.  The caller's reference to that end
+   passes to T.  Returns -1 if T is full or memory is
+   exhausted. */
+int
+fd_alloc_pipe (struct fd_table *t, struct pipe *pipe, bool write_end)
+{
+  struct fd_entry e;
+
+  ASSERT (pipe != NULL);
+
+  e.file = NULL;
+  e.pipe = pipe;
+  e.write_end = write_end;
+  e.nonblock = false;
+  return install (t, &e);
+}
+
+/* Installs a new handle to whatever FD is open on in SRC, in the
+   lowest free descriptor of DST, and returns that descriptor.  A
+   file is reopened at the same position; a pipe end is shared.
+   Returns -1 if FD is not open in SRC, DST is full, or memory is
+   exhausted.  The caller must hold the file system lock. */
+int
+fd_dup (struct fd_table *dst, const struct fd_table *src, int fd)
+{
+  struct fd_entry e;
+  int new_fd;
+
+  if (fd < FD_MIN || (size_t) fd >= src->cap
+      || !bitmap_test (src->used, fd)
+      || !copy_entry (&e, &src->entries[fd]))
+    return -1;
+  new_fd = install (dst, &e);
+  if (new_fd < 0)
+    close_entry (&e);
+  return new_fd;
+}
+
+/* Returns the file open as FD in T, or a null pointer if FD is
+   not open or is open on a pipe. */
+struct file *
+fd_lookup (const struct fd_table *t, int fd)
+{
+  if (fd < FD_MIN || (size_t) fd >= t->cap)
+    return NULL;
+  return t->entries[fd].file;
+}
+
+/* Returns the pipe that FD is open on in T, and sets *WRITE_END
+   to whether it is the pipe's write end.  Returns a null pointer
+   if FD is not open or is open on a file. */
+struct pipe *
+fd_lookup_pipe (const struct fd_table *t, int fd, bool *write_end)
+{
+  if (fd < FD_MIN || (size_t) fd >= t->cap)
+    return NULL;
+  *write_end = t->entries[fd].write_end;
+  return t->entries[fd].pipe;
+}
+
+/* Closes descriptor FD in T, closing the file or pipe end open
+   on it.  Returns false if FD is not open. */
+bool
+fd_close (struct fd_table *t, int fd)
+{
+  if (fd < FD_MIN || (size_t) fd >= t->cap || !bitmap_test (t->used, fd))
+    return false;
+  close_entry (&t->entries[fd]);
+  t->entries[fd].file = NULL;
+  t->entries[fd].pipe = NULL;
+  bitmap_reset (t->used, fd);
+  return true;
+}
+
+/* Makes reads from FD in T return at once, instead of waiting,
+   when no data is available, if NONBLOCK is true, or wait again
+   if it is false.  This matters for the console, fd 0, and for
+   pipes; reads from a file never wait anyway.  Returns false if
+   FD is neither 0 nor open. */
+bool
+fd_set_nonblock (struct fd_table *t, int fd, bool nonblock)
+{
+  if (fd == 0)
+    t->nonblock_stdin = nonblock;
+  else if (fd >= FD_MIN && (size_t) fd < t->cap && bitmap_test (t->used, fd))
+    t->entries[fd].nonblock = nonblock;
+  else
+    return false;
+  return true;
+}
+
+/* Returns true if reads from FD in T do not wait for data. */
+bool
+fd_is_nonblock (const struct fd_table *t, int fd)
+{
+  if (fd == 0)
+    return t->nonblock_stdin;
+  if (fd < FD_MIN || (size_t) fd >= t->cap)
+    return false;
+  return t->entries[fd].nonblock;
+}
+
+/* Copies E into the lowest free descriptor of T, growing T if
+   necessary, and returns the descriptor.
+   Returns -1 if T is full or memory is exhausted. */
+static int
+install (struct fd_table *t, const struct fd_entry *e)
+{
+  size_t fd = BITMAP_ERROR;
+
+  if (t->used != NULL)
+    fd = bitmap_scan_and_flip (t->used, FD_MIN, 1, false);
+  if (fd == BITMAP_ERROR)
+    {
+      size_t cap = t->cap;
+      if (!grow (t, cap + 1))
+        return -1;
+      fd = bitmap_scan_and_flip (t->used, cap, 1, false);
+      ASSERT (fd != BITMAP_ERROR);
+    }
+
+  t->entries[fd] = *e;
+  return fd;
+}
+
+/* Makes DST a new handle to what SRC is open on: the same file,
+   reopened at the same position, or the same pipe end.  Returns
+   false if memory is exhausted. */
+static bool
+copy_entry (struct fd_entry *dst, const struct fd_entry *src)
+{
+  *dst = *src;
+  if (src->pipe != NULL)
+    pipe_dup (src->pipe, src->write_end);
+  else
+    {
+      dst->file = file_reopen (src->file);
+      if (dst->file == NULL)
+        return false;
+      file_seek (dst->file, file_tell (src->file));
+    }
+  return true;
+}
+
+/* Closes the file or pipe end open in E. */
+static void
+close_entry (struct fd_entry *e)
+{
+  if (e->pipe != NULL)
+    pipe_close (e->pipe, e->write_end);
+  else
+    file_close (e->file);
+}
+
+/* Grows T to at least MIN_CAP slots, by doubling.
+   Returns true if successful, false if MIN_CAP exceeds FD_MAX or
+   memory is exhausted, in which case T is unchanged. */
+static bool
+grow (struct fd_table *t, size_t min_cap)
+{
+  size_t new_cap = t->cap > 0 ? t->cap : FD_INIT_CNT;
+  struct fd_entry *entries;
+  struct bitmap *used;
+  size_t i;
+
+  while (new_cap < min_cap)
+    new_cap *= 2;
+  if (new_cap > FD_MAX)
+    new_cap = FD_MAX;
+  if (new_cap < min_cap)
+    return false;
+
+  used = bitmap_create (new_cap);
+  if (used == NULL)
+    return false;
+  entries = realloc (t->entries, new_cap * sizeof *entries);
+  if (entries == NULL)
+    {
+      bitmap_destroy (used);
+      return false;
+    }
+
+  if (t->used != NULL)
+    {
+      for (i = 0; i < t->cap; i++)
+        bitmap_set (used, i, bitmap_test (t->used, i));
+      bitmap_destroy (t->used);
+    }
+  else
+    bitmap_set_multiple (used, 0, FD_MIN, true);
+  for (i = t->cap; i < new_cap; i++)
+    {
+      entries[i].file = NULL;
+      entries[i].pipe = NULL;
+      entries[i].write_end = false;
+      entries[i].nonblock = false;
+    }
+
+  t->entries = entries;
+  t->used = used;
+  t->cap = new_cap;
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+struct pipe;
+struct bitmap;
+
+/* Lowest file descriptor handed out by fd_alloc().
+   Descriptors 0 and 1 are the console, and 2 is left unused, as
+   a process's standard error, so that open() keeps returning 3
+   for its first file. */
+#define FD_MIN 3
+
+/* Maximum number of file descriptors per process. */
+#define FD_MAX 8192
+
+/* What a file descriptor is open on: a file, or one end of a
+   pipe. */
+struct fd_entry
+  {
+    struct file *file;          /* Open file, or null for a pipe. */
+    struct pipe *pipe;          /* Pipe, if FILE is null. */
+    bool write_end;             /* Whether PIPE's write end is open. */
+    bool nonblock;              /* Reads do not wait for data. */
+  };
+
+/* A process's file descriptor table.
+   Allocated separately from the thread, and grown by doubling as
+   descriptors are opened, so that it costs nothing on the
+   thread's kernel stack page. */
+struct fd_table
+  {
+    struct fd_entry *entries;   /* Open descriptors, indexed by fd. */
+    struct bitmap *used;        /* Descriptors in use. */
+    size_t cap;                 /* Number of slots in ENTRIES and USED. */
+    bool nonblock_stdin;        /* Reads from fd 0 do not wait. */
+  };
+
+void fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+bool fd_table_copy (struct fd_table *dst, const struct fd_table *src);
+int fd_alloc (struct fd_table *, struct file *);
+int fd_alloc_pipe (struct fd_table *, struct pipe *, bool write_end);
+int fd_dup (struct fd_table *dst, const struct fd_table *src, int fd);
+struct file *fd_lookup (const struct fd_table *, int fd);
+struct pipe *fd_lookup_pipe (const struct fd_table *, int fd,
+                             bool *write_end);
+bool fd_close (struct fd_table *, int fd);
+bool fd_set_nonblock (struct fd_table *, int fd, bool nonblock);
+bool fd_is_nonblock (const struct fd_table *, int fd);
+
+#endif /* userprog/fdtable.h */
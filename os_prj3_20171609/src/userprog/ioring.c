@@ -0,0 +1,204 @@
+#include "userprog/ioring.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
+
+/* Kernel side of a process's ring.
+
+   The kernel reaches the shared page through its own mapping of
+   the frame, so it never faults on it, and keeps private copies
+   of the indexes it owns so that a process scribbling on the
+   shared page cannot confuse it. */
+struct io_ring
+  {
+    struct io_ring_page *page;  /* Shared page (kernel address). */
+    void *upage;                /* Where PAGE is mapped for the process. */
+#ifdef VM
+    struct frame *frame;        /* Wired frame holding PAGE. */
+#endif
+    uint32_t sq_head;           /* Authoritative copy of PAGE->sq_head. */
+    uint32_t cq_tail;           /* Authoritative copy of PAGE->cq_tail. */
+  };
+
+static int run_sqe (const struct io_ring_sqe *);
+
+/* Creates a ring for the current process and maps its shared
+   page at user address ADDR, which must be page-aligned and not
+   already mapped.  A process may have only one ring.
+   Returns 0 if successful, -1 on failure. */
+int
+io_ring_setup (void *addr)
+{
+  struct thread *t = thread_current ();
+  struct io_ring *ring;
+
+  ASSERT (sizeof (struct io_ring_page) <= PGSIZE);
+
+  if (t->io_ring != NULL || addr == NULL || pg_ofs (addr) != 0
+      || !is_user_vaddr (addr) || pagedir_get_page (t->pagedir, addr) != NULL)
+    return -1;
+#ifdef VM
+  if (page_lookup (addr) != NULL)
+    return -1;
+#endif
+
+  ring = malloc (sizeof *ring);
+  if (ring == NULL)
+    return -1;
+#ifdef VM
+  /* Map the page through the supplemental page table, so that
+     the rest of the VM code knows the address is taken. */
+  lock_acquire (&frame_lock);
+  ring->frame = frame_alloc_wired ();
+  lock_release (&frame_lock);
+  if (ring->frame == NULL)
+    {
+      free (ring);
+      return -1;
+    }
+  ring->page = ring->frame->kpage;
+  if (!page_add_wired (addr, ring->frame, true))
+    {
+      lock_acquire (&frame_lock);
+      frame_release (ring->frame);
+      lock_release (&frame_lock);
+      free (ring);
+      return -1;
+    }
+#else
+  ring->page = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (ring->page == NULL)
+    {
+      free (ring);
+      return -1;
+    }
+  if (!pagedir_set_page (t->pagedir, addr, ring->page, true))
+    {
+      palloc_free_page (ring->page);
+      free (ring);
+      return -1;
+    }
+#endif
+  ring->upage = addr;
+  ring->sq_head = 0;
+  ring->cq_tail = 0;
+
+  t->io_ring = ring;
+  return 0;
+}
+
+/* Runs up to TO_SUBMIT operations queued in the current process's
+   submission queue, posting each result to the completion queue.
+   Stops early if the submission queue runs dry or the completion
+   queue fills up.  Returns the number of operations run, or -1 if
+   the process has no ring.
+
+   Each operation behaves exactly like the corresponding system
+   call; in particular, a bad buffer or file descriptor
+   terminates the process. */
+int
+io_ring_enter (unsigned to_submit)
+{
+  struct io_ring *ring = thread_current ()->io_ring;
+  struct io_ring_page *page;
+  unsigned submitted;
+
+  if (ring == NULL)
+    return -1;
+  page = ring->page;
+
+  for (submitted = 0; submitted < to_submit; submitted++)
+    {
+      struct io_ring_sqe sqe;
+      struct io_ring_cqe *cqe;
+
+      if (ring->sq_head == page->sq_tail
+          || ring->cq_tail - page->cq_head >= IO_RING_CQ_ENTRIES)
+        break;
+
+      /* Take a private copy of the entry before acting on it, so
+         that the process cannot change it underneath us. */
+      sqe = page->sqes[ring->sq_head % IO_RING_SQ_ENTRIES];
+      page->sq_head = ++ring->sq_head;
+
+      cqe = &page->cqes[ring->cq_tail % IO_RING_CQ_ENTRIES];
+      cqe->user_data = sqe.user_data;
+      cqe->res = run_sqe (&sqe);
+
+      /* Publish the completion only after it is filled in. */
+      barrier ();
+      page->cq_tail = ++ring->cq_tail;
+    }
+  return submitted;
+}
+
+/* Unmaps and frees T's ring, if it has one.  T must be the
+   running thread.  Must be called before T's supplemental page
+   table and page directory are destroyed. */
+void
+io_ring_destroy (struct thread *t)
+{
+  struct io_ring *ring = t->io_ring;
+
+  ASSERT (t == thread_current ());
+
+  if (ring == NULL)
+    return;
+#ifdef VM
+  page_remove (ring->upage);
+  lock_acquire (&frame_lock);
+  frame_release (ring->frame);
+  lock_release (&frame_lock);
+#else
+  pagedir_clear_page (t->pagedir, ring->upage);
+  palloc_free_page (ring->page);
+#endif
+  free (ring);
+  t->io_ring = NULL;
+}
+
+/* Performs the operation described by SQE and returns its
+   result. */
+static int
+run_sqe (const struct io_ring_sqe *sqe)
+{
+  switch (sqe->opcode)
+    {
+    case IO_RING_NOP:
+      return 0;
+
+    case IO_RING_READ:
+      if (sqe->off == -1)
+        return read (sqe->fd, (void *) sqe->addr, sqe->len);
+      return pread (sqe->fd, (void *) sqe->addr, sqe->len, sqe->off);
+
+    case IO_RING_WRITE:
+      if (sqe->off == -1)
+        return write (sqe->fd, (const void *) sqe->addr, sqe->len);
+      return pwrite (sqe->fd, (const void *) sqe->addr, sqe->len, sqe->off);
+
+    case IO_RING_OPEN:
+      {
+        char *name = copy_in_string ((const char *) sqe->addr);
+        int fd = open (name);
+        palloc_free_page (name);
+        return fd;
+      }
+
+    case IO_RING_CLOSE:
+      close (sqe->fd);
+      return 0;
+
+    default:
+      return -1;
+    }
+}
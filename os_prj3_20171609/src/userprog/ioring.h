@@ -0,0 +1,75 @@
+#ifndef USERPROG_IORING_H
+#define USERPROG_IORING_H
+
+#include <stdint.h>
+
+/* Submission/completion rings for batched system calls.
+
+   A process maps one page shared with the kernel with
+   io_ring_setup(), queues operations in its submission queue
+   (SQ), and then makes a single io_ring_enter() call to have the
+   kernel run all of them.  Each operation's result is posted to
+   the completion queue (CQ), tagged with the submitter's
+   USER_DATA.
+
+   The operations run synchronously, one after another, inside
+   io_ring_enter(): the ring saves traps, but it does not overlap
+   operations with each other or with the process, and there is
+   no kernel thread polling the SQ.
+
+   The process owns SQ_TAIL and CQ_HEAD; the kernel owns SQ_HEAD
+   and CQ_TAIL.  Indexes run freely and are reduced modulo the
+   queue size when used, so a queue is empty when its head equals
+   its tail. */
+
+/* Queue sizes.  Powers of 2, chosen so that struct io_ring_page
+   fits in a single page. */
+#define IO_RING_SQ_ENTRIES 64
+#define IO_RING_CQ_ENTRIES (2 * IO_RING_SQ_ENTRIES)
+
+/* Operations. */
+enum io_ring_op
+  {
+    IO_RING_NOP,                /* Do nothing. */
+    IO_RING_READ,               /* read(), or pread() if OFF != -1. */
+    IO_RING_WRITE,              /* write(), or pwrite() if OFF != -1. */
+    IO_RING_OPEN,               /* open() the file named at ADDR. */
+    IO_RING_CLOSE               /* close(). */
+  };
+
+/* Submission queue entry. */
+struct io_ring_sqe
+  {
+    uint32_t opcode;            /* One of enum io_ring_op. */
+    int32_t fd;                 /* File descriptor. */
+    uint32_t addr;              /* Buffer or file name, in user memory. */
+    uint32_t len;               /* Buffer length. */
+    int32_t off;                /* File offset, or -1 for current position. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* Completion queue entry. */
+struct io_ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int32_t res;                /* System call's return value. */
+  };
+
+/* Layout of the page shared between a process and the kernel. */
+struct io_ring_page
+  {
+    volatile uint32_t sq_head;  /* Next SQE the kernel will consume. */
+    volatile uint32_t sq_tail;  /* Next SQE the process will fill. */
+    volatile uint32_t cq_head;  /* Next CQE the process will consume. */
+    volatile uint32_t cq_tail;  /* Next CQE the kernel will fill. */
+    struct io_ring_sqe sqes[IO_RING_SQ_ENTRIES];
+    struct io_ring_cqe cqes[IO_RING_CQ_ENTRIES];
+  };
+
+struct thread;
+
+int io_ring_setup (void *addr);
+int io_ring_enter (unsigned to_submit);
+void io_ring_destroy (struct thread *);
+
+#endif /* userprog/ioring.h */
@@ -156,6 +156,28 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Sets user virtual page UPAGE in PD writable if WRITABLE is
+   true, otherwise read-only.  Other bits in the page table entry
+   are preserved.  UPAGE need not be mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (pd, upage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -0,0 +1,223 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Pipes.
+
+   A pipe is a page-sized ring buffer with one read end and one
+   write end, each of which may be open in any number of file
+   descriptors.  Readers are serialized among themselves by
+   READ_LOCK and writers by WRITE_LOCK, so that the ring itself
+   only ever has a single producer and a single consumer.  The
+   producer alone advances HEAD and the consumer alone advances
+   TAIL, so neither end locks the other out while copying data.
+
+   An end only sleeps when the ring is empty (for the reader) or
+   full (for the writer).  Before sleeping it sets its WAITING
+   flag and checks the ring once more, and the other end only ups
+   the semaphore if it finds the flag set after moving its index.
+   Either the sleeper sees the other end's progress or the other
+   end sees the flag, so no wakeup is lost, and a stray up only
+   costs the sleeper one extra look at the ring. */
+
+/* Size of the ring buffer in bytes.  Must be a power of 2. */
+#define PIPE_SIZE PGSIZE
+
+struct pipe
+  {
+    uint8_t *buf;               /* Ring buffer, PIPE_SIZE bytes. */
+    uint32_t head;              /* Total bytes written. */
+    uint32_t tail;              /* Total bytes read. */
+
+    struct lock read_lock;      /* Serializes readers. */
+    struct lock write_lock;     /* Serializes writers. */
+    struct semaphore readable;  /* Upped when a sleeping reader may go. */
+    struct semaphore writable;  /* Upped when a sleeping writer may go. */
+    bool reader_waiting;        /* Reader is about to sleep. */
+    bool writer_waiting;        /* Writer is about to sleep. */
+
+    struct lock ref_lock;       /* Protects the open counts. */
+    int readers;                /* Descriptors open on the read end. */
+    int writers;                /* Descriptors open on the write end. */
+  };
+
+static void wake (struct semaphore *, bool *waiting);
+
+/* Creates a new pipe with its read end and its write end each
+   open once.  Returns the pipe, or a null pointer if memory is
+   exhausted. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+
+  if (p == NULL)
+    return NULL;
+  p->buf = palloc_get_page (0);
+  if (p->buf == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  p->head = p->tail = 0;
+  lock_init (&p->read_lock);
+  lock_init (&p->write_lock);
+  sema_init (&p->readable, 0);
+  sema_init (&p->writable, 0);
+  p->reader_waiting = p->writer_waiting = false;
+  lock_init (&p->ref_lock);
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Records one more descriptor open on the write end of P if
+   WRITE_END is true, or on its read end otherwise. */
+void
+pipe_dup (struct pipe *p, bool write_end)
+{
+  lock_acquire (&p->ref_lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->ref_lock);
+}
+
+/* Closes one descriptor open on the write end of P if WRITE_END
+   is true, or on its read end otherwise.  Closing the last write
+   end lets the reader see end of file, and closing the last read
+   end makes further writes fail.  P is freed once both ends are
+   closed. */
+void
+pipe_close (struct pipe *p, bool write_end)
+{
+  bool last;
+
+  lock_acquire (&p->ref_lock);
+  if (write_end)
+    {
+      ASSERT (p->writers > 0);
+      if (--p->writers == 0)
+        sema_up (&p->readable);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      if (--p->readers == 0)
+        sema_up (&p->writable);
+    }
+  last = p->readers == 0 && p->writers == 0;
+  lock_release (&p->ref_lock);
+
+  if (last)
+    {
+      palloc_free_page (p->buf);
+      free (p);
+    }
+}
+
+/* Reads up to SIZE bytes from P into kernel BUFFER.  If the ring
+   is empty but the write end is still open, waits for data if
+   BLOCK is true, or returns -1 at once otherwise.  Returns the
+   number of bytes read, which is 0 only at end of file, that is,
+   once the ring is empty and the write end is closed. */
+int
+pipe_read (struct pipe *p, void *buffer, size_t size, bool block)
+{
+  uint8_t *dst = buffer;
+  uint32_t avail, ofs, chunk;
+
+  lock_acquire (&p->read_lock);
+  for (;;)
+    {
+      avail = p->head - p->tail;
+      if (avail > 0 || p->writers == 0 || !block)
+        break;
+      p->reader_waiting = true;
+      barrier ();
+      if (p->head == p->tail && p->writers > 0)
+        sema_down (&p->readable);
+      p->reader_waiting = false;
+    }
+
+  if (avail == 0 && p->writers > 0 && size > 0)
+    {
+      lock_release (&p->read_lock);
+      return -1;
+    }
+
+  if (size > avail)
+    size = avail;
+  ofs = p->tail % PIPE_SIZE;
+  chunk = size < PIPE_SIZE - ofs ? size : PIPE_SIZE - ofs;
+  memcpy (dst, p->buf + ofs, chunk);
+  memcpy (dst + chunk, p->buf, size - chunk);
+  barrier ();
+  p->tail += size;
+  barrier ();
+  if (size > 0)
+    wake (&p->writable, &p->writer_waiting);
+  lock_release (&p->read_lock);
+  return size;
+}
+
+/* Writes the SIZE bytes in kernel BUFFER to P, waiting for room
+   in the ring as necessary.  Returns the number of bytes
+   written, which is less than SIZE only if the read end is
+   closed, or -1 if it was already closed before anything was
+   written. */
+int
+pipe_write (struct pipe *p, const void *buffer, size_t size)
+{
+  const uint8_t *src = buffer;
+  size_t done = 0;
+
+  lock_acquire (&p->write_lock);
+  while (done < size)
+    {
+      uint32_t room, ofs, chunk, n;
+
+      if (p->readers == 0)
+        break;
+      room = PIPE_SIZE - (p->head - p->tail);
+      if (room == 0)
+        {
+          p->writer_waiting = true;
+          barrier ();
+          if (p->head - p->tail == PIPE_SIZE && p->readers > 0)
+            sema_down (&p->writable);
+          p->writer_waiting = false;
+          continue;
+        }
+
+      n = size - done < room ? size - done : room;
+      ofs = p->head % PIPE_SIZE;
+      chunk = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+      memcpy (p->buf + ofs, src + done, chunk);
+      memcpy (p->buf, src + done + chunk, n - chunk);
+      barrier ();
+      p->head += n;
+      barrier ();
+      wake (&p->readable, &p->reader_waiting);
+      done += n;
+    }
+  lock_release (&p->write_lock);
+  return done == 0 && size > 0 ? -1 : (int) done;
+}
+
+/* Wakes the other end of a pipe, sleeping on SEMA, if *WAITING
+   says that it has gone or is about to go to sleep. */
+static void
+wake (struct semaphore *sema, bool *waiting)
+{
+  if (*waiting)
+    {
+      *waiting = false;
+      sema_up (sema);
+    }
+}
@@ -0,0 +1,15 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_dup (struct pipe *, bool write_end);
+void pipe_close (struct pipe *, bool write_end);
+int pipe_read (struct pipe *, void *buffer, size_t size, bool block);
+int pipe_write (struct pipe *, const void *buffer, size_t size);
+
+#endif /* userprog/pipe.h */
@@ -1,12 +1,17 @@
 #include "userprog/process.h"
 #include <debug.h>
+#include <hash.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
+#include "userprog/conout.h"
+#include "userprog/ioring.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "userprog/vdso.h"
 #include "userprog/syscall.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -14,108 +19,323 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "lib/stdio.h"
 #include "lib/string.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#endif
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+#ifdef VM
+static thread_func fork_process NO_RETURN;
+#endif
+static bool load (const char *cmdline, struct file *,
+                  void (**eip) (void), void **esp);
+
+/* Exit status of a child process.
+
+   Shared by the child and its parent, and freed by whichever of
+   the two lets go of it last, so that a child can exit, and have
+   its thread and address space freed, without waiting for the
+   parent to wait() for it.  The parent finds its children's
+   records by tid in its `children' hash. */
+struct child_status
+  {
+    struct hash_elem elem;      /* Element in parent's `children'. */
+    tid_t tid;                  /* Child's thread id. */
+    int exit_status;            /* Child's exit status. */
+    struct semaphore exited;    /* Upped when the child exits. */
+    struct lock lock;           /* Protects REF_CNT. */
+    int ref_cnt;                /* 2 while parent and child are alive. */
+  };
+
+static bool children_init (void);
+static struct child_status *child_status_create (void);
+static void child_status_add (struct child_status *, tid_t);
+static void child_status_release (struct child_status *);
+static hash_action_func child_status_orphan;
+static hash_hash_func child_status_hash;
+static hash_less_func child_status_less;
+
+/* Passed from process_spawn() to the child's start_process(). */
+struct exec_info
+  {
+    char *cmd_line;             /* Command line, in a page. */
+    struct file *file;          /* Executable, already open. */
+    struct fd_table fds;        /* Descriptors the child inherits. */
+    struct child_status *status; /* Child's exit status record. */
+    struct semaphore loaded;    /* Upped once the load is done. */
+    bool success;               /* Whether the load succeeded. */
+    bool nowait;                /* True if the parent did not wait. */
+  };
 
-void func_input_command(const char* file_name, char* command);
-void calculate_esp(const char* input, void** esp);
 
+/* Starts a new process running the program named by the first
+   word of FILE_NAME, and waits for it to load.  Returns the new
+   process's thread id, or TID_ERROR if the program cannot be
+   opened or loaded or the thread cannot be created. */
 tid_t
 process_execute(const char *file_name)
 {
-	char *fn_copy;
+	return process_spawn(file_name, NULL, 0, false);
+}
+
+/* Starts a new process running the program named by the first
+   word of CMD_LINE, which may be up to a page long.
+
+   The new process starts out with a handle to each of the FD_CNT
+   descriptors in FDS of the current process, at the same
+   position, as its descriptors FD_MIN, FD_MIN + 1, and so on.
+
+   The executable is opened, and the descriptors copied, here, so
+   that those errors are reported without creating a thread at
+   all.  If NOWAIT is false, waits for the new process to load
+   its image and fails if it cannot; otherwise returns as soon as
+   the thread exists and leaves the load to run alongside the
+   caller, in which case a failed load shows up as an exit
+   status of -1 from process_wait().
+
+   Returns the new process's thread id, or TID_ERROR on
+   failure. */
+tid_t
+process_spawn(const char *cmd_line, const int *fds, size_t fd_cnt,
+              bool nowait)
+{
+	struct exec_info *info;
+	struct child_status *status;
 	tid_t tid;
-	char command[256];
+	char prog_name[NAME_MAX + 1];
+	size_t len;
+	size_t i;
 
-	func_input_command(file_name, command);
+	cmd_line += strspn(cmd_line, " ");
+	len = strcspn(cmd_line, " ");
+	if (len == 0 || len > NAME_MAX)
+		return TID_ERROR;
+	memcpy(prog_name, cmd_line, len);
+	prog_name[len] = '\0';
 
-	fn_copy = palloc_get_page(0);
-	if (fn_copy == NULL)
+	if (!children_init())
+		return TID_ERROR;
+	info = malloc(sizeof *info);
+	if (info == NULL)
 		return TID_ERROR;
-	strlcpy(fn_copy, file_name, PGSIZE);
+	fd_table_init(&info->fds);
+	info->cmd_line = NULL;
+	info->status = NULL;
+
+	lock_acquire(&lockflag);
+	info->file = filesys_open(prog_name);
+	for (i = 0; info->file != NULL && i < fd_cnt; i++)
+		if (fd_dup(&info->fds, &thread_current()->fds, fds[i]) < 0)
+			break;
+	lock_release(&lockflag);
+	if (info->file == NULL || i < fd_cnt)
+		goto fail;
+	info->cmd_line = palloc_get_page(0);
+	info->status = child_status_create();
+	if (info->cmd_line == NULL || info->status == NULL)
+		goto fail;
+	strlcpy(info->cmd_line, cmd_line, PGSIZE);
+	sema_init(&info->loaded, 0);
+	info->success = false;
+	info->nowait = nowait;
+	status = info->status;
+
+	/* Create a new thread to execute CMD_LINE.  Once it is
+	   running, INFO belongs to it if NOWAIT is true. */
+	tid = thread_create(prog_name, PRI_DEFAULT, start_process, info);
+	if (tid == TID_ERROR)
+		goto fail;
 
-	if (!filesys_open(command))
-		return -1;
+	if (!nowait) {
+		bool success;
 
-	/* Create a new thread to execute FILE_NAME. */
-	tid = thread_create(command, PRI_DEFAULT, start_process, fn_copy);
-	if (tid == TID_ERROR)
-		palloc_free_page(fn_copy);
+		sema_down(&info->loaded);
+		success = info->success;
+		free(info);
+		if (!success) {
+			child_status_release(status);
+			return TID_ERROR;
+		}
+	}
+	child_status_add(status, tid);
 	return tid;
+
+fail:
+	palloc_free_page(info->cmd_line);
+	free(info->status);
+	lock_acquire(&lockflag);
+	file_close(info->file);
+	fd_table_destroy(&info->fds);
+	lock_release(&lockflag);
+	free(info);
+	return TID_ERROR;
 }
 
 
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-	char *file_name = file_name_;
+	struct exec_info *info = info_;
+	char *file_name = info->cmd_line;
+	struct thread *t = thread_current();
 	struct intr_frame if_;
 	bool success;
-	int qrts;
+
+	t->status = info->status;
+	t->fds = info->fds;
 
 	memset(&if_, 0, sizeof if_);
 	if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
 	if_.cs = SEL_UCSEG;
 	if_.eflags = FLAG_IF | FLAG_MBS;
 	
-	success = load(file_name, &if_.eip, &if_.esp);
-	qrts = qrts + 1;
-
+	success = load(file_name, info->file, &if_.eip, &if_.esp);
 	palloc_free_page(file_name);
-	sema_up(&thread_current()->parent->load);
-    if (!success) {
-        thread_current()->loaded = 0;
-        exit(-1);
-    }
-  else
-    thread_current()->loaded = 1;
+
+	/* A waiting parent frees INFO as soon as it wakes up, so it
+	   must not be touched after sema_up(). */
+	if (info->nowait)
+		free(info);
+	else {
+		info->success = success;
+		sema_up(&info->loaded);
+	}
+	if (!success)
+		exit(-1);
 
 	asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
 	NOT_REACHED();
 }
 
+#ifdef VM
+/* Passed from process_fork() to the child's fork_process(). */
+struct fork_info
+  {
+    struct thread *parent;      /* Process being forked. */
+    struct intr_frame if_;      /* Parent's user context. */
+    struct child_status *status; /* Child's exit status record. */
+    struct semaphore done;      /* Upped when the child is set up. */
+    bool success;               /* Whether the child was set up. */
+  };
+
+/* Creates a child process that is a copy of the current one,
+   resuming in user mode from IF_ with 0 as the return value of
+   the system call.  The child's memory is shared copy-on-write
+   with the parent, so only page tables are copied up front.
+   Returns the child's thread id, or TID_ERROR if the child could
+   not be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_info info;
+  tid_t tid;
+
+  if (!children_init ())
+    return TID_ERROR;
+  info.parent = thread_current ();
+  info.if_ = *if_;
+  info.status = child_status_create ();
+  if (info.status == NULL)
+    return TID_ERROR;
+  sema_init (&info.done, 0);
+  info.success = false;
+
+  tid = thread_create (thread_name (), thread_get_priority (),
+                       fork_process, &info);
+  if (tid == TID_ERROR)
+    {
+      free (info.status);
+      return TID_ERROR;
+    }
+  sema_down (&info.done);
+  if (!info.success)
+    {
+      child_status_release (info.status);
+      return TID_ERROR;
+    }
+  child_status_add (info.status, tid);
+  return tid;
+}
+
+/* A thread function that sets up a forked child process as a copy
+   of the parent described by INFO_ and starts it running. */
+static void
+fork_process (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  t->status = info->status;
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  if (!page_table_init ())
+    {
+      pagedir_destroy (t->pagedir);
+      t->pagedir = NULL;
+      goto done;
+    }
+  process_activate ();
+
+  lock_acquire (&lockflag);
+  t->exec_file = file_reopen (parent->exec_file);
+  if (t->exec_file != NULL)
+    file_deny_write (t->exec_file);
+  success = t->exec_file != NULL && fd_table_copy (&t->fds, &parent->fds);
+  lock_release (&lockflag);
+
+  success = success && page_table_copy (parent) && vdso_map ();
+
+ done:
+  /* INFO lives on the parent's stack, so it is gone once the
+     parent wakes up. */
+  info->success = success;
+  sema_up (&info->done);
+  if (!success)
+    exit (-1);
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
 
+/* Waits for child process CHILD_TID to exit and returns its exit
+   status.  Returns -1 at once if CHILD_TID is not a child of the
+   current process, or has already been waited for. */
 int
 process_wait (tid_t child_tid) 
 {
-	struct thread *parent = thread_current();
-	struct thread *tmp_thre;
-	struct list_elem* e;
-
-	int i = 0, exit_status;
-	int switch_byun;
-
-	thread_current()->waiting = 1;
-	for (e = list_begin(&(thread_current()->child)); i < list_size(&(thread_current()->child)); e = list_next(e))
-	{
-		tmp_thre = list_entry(e, struct thread, child_elem);
-		if (tmp_thre->tid == child_tid) 
-		{
-		 switch_byun = 1;
-		  break;
-		}
-		i++;
-	}
-
-	  if (i >= list_size(&(thread_current()->child)) || tmp_thre->parent != thread_current() || tmp_thre->waiting)
-		return -1;
-
-	  if (switch_byun && tmp_thre){
-		sema_down(&(tmp_thre->exit));
-		exit_status = tmp_thre->exit_status;
-		list_remove(&(tmp_thre->child_elem));
-		sema_up(&(tmp_thre->wait));
-		return exit_status;
-	  }
-	  else 
-		return -1;
+  struct hash *children = thread_current ()->children;
+  struct child_status key;
+  struct child_status *c;
+  struct hash_elem *e;
+  int exit_status;
+
+  if (children == NULL)
+    return -1;
+  key.tid = child_tid;
+  e = hash_delete (children, &key.elem);
+  if (e == NULL)
+    return -1;
+  c = hash_entry (e, struct child_status, elem);
+
+  sema_down (&c->exited);
+  exit_status = c->exit_status;
+  child_status_release (c);
+  return exit_status;
 }
 
 void
@@ -124,19 +344,46 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
-  sema_up(&(cur->exit));
-  sema_down(&cur->wait);
+  fd_table_destroy (&cur->fds);
 
   pd = cur->pagedir;
 
   if (pd != NULL) 
     {
+      /* Let everything the process wrote reach the console before
+         any kernel message about its exit. */
+      conout_flush ();
+      io_ring_destroy (cur);
+      vdso_unmap ();
+#ifdef VM
+      mmap_unmap_all ();
+      shm_unmap_all ();
+      page_table_destroy ();
+#endif
 
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
 
+  file_close (cur->exec_file);
+  cur->exec_file = NULL;
+
+  /* Let go of our children, and report to our parent, last, so
+     that everything else is freed by the time it hears of it. */
+  if (cur->children != NULL)
+    {
+      hash_destroy (cur->children, child_status_orphan);
+      free (cur->children);
+      cur->children = NULL;
+    }
+  if (cur->status != NULL)
+    {
+      cur->status->exit_status = cur->exit_status;
+      sema_up (&cur->status->exited);
+      child_status_release (cur->status);
+      cur->status = NULL;
+    }
 }
 
 void
@@ -145,6 +392,92 @@ process_activate (void)
   struct thread *t = thread_current ();
   pagedir_activate (t->pagedir);
   tss_update ();
+  vdso_set_tid (t->tid);
+}
+
+/* Creates the current process's table of children, if it does
+   not have one yet.  Returns true if successful, false if memory
+   is exhausted. */
+static bool
+children_init (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (cur->children != NULL)
+    return true;
+  cur->children = malloc (sizeof *cur->children);
+  if (cur->children == NULL)
+    return false;
+  if (!hash_init (cur->children, child_status_hash, child_status_less, NULL))
+    {
+      free (cur->children);
+      cur->children = NULL;
+      return false;
+    }
+  return true;
+}
+
+/* Returns a new child status record, with one reference for the
+   parent and one for the child, or a null pointer if memory is
+   exhausted. */
+static struct child_status *
+child_status_create (void)
+{
+  struct child_status *c = malloc (sizeof *c);
+
+  if (c != NULL)
+    {
+      c->exit_status = -1;
+      sema_init (&c->exited, 0);
+      lock_init (&c->lock);
+      c->ref_cnt = 2;
+    }
+  return c;
+}
+
+/* Enters C, the record of new child TID, in the current process's
+   table of children. */
+static void
+child_status_add (struct child_status *c, tid_t tid)
+{
+  c->tid = tid;
+  hash_insert (thread_current ()->children, &c->elem);
+}
+
+/* Drops a reference to C, freeing it if it was the last. */
+static void
+child_status_release (struct child_status *c)
+{
+  bool last;
+
+  lock_acquire (&c->lock);
+  last = --c->ref_cnt == 0;
+  lock_release (&c->lock);
+  if (last)
+    free (c);
+}
+
+/* Drops the exiting parent's reference to child status E. */
+static void
+child_status_orphan (struct hash_elem *e, void *aux UNUSED)
+{
+  child_status_release (hash_entry (e, struct child_status, elem));
+}
+
+/* Returns a hash value for child status E. */
+static unsigned
+child_status_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct child_status, elem)->tid);
+}
+
+/* Returns true if child status A precedes child status B. */
+static bool
+child_status_less (const struct hash_elem *a, const struct hash_elem *b,
+                   void *aux UNUSED)
+{
+  return (hash_entry (a, struct child_status, elem)->tid
+          < hash_entry (b, struct child_status, elem)->tid);
 }
 
 
@@ -204,42 +537,61 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (void **esp);
+static bool setup_stack (void **esp, size_t size);
+static void push_args (char *cmd_line, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
+static int coalesce_segments (struct Elf32_Phdr *, int cnt);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
+/* Loads an ELF executable from FILE, which the caller has opened
+   and which load() takes over, into the current thread, with
+   arguments from CMD_LINE.  Stores the executable's entry point
+   into *EIP and its initial stack pointer into *ESP.  Returns true
+   if successful, false otherwise. */
 bool
-load(const char* file_name, void (**eip) (void), void** esp)
+load(const char* file_name, struct file *file, void (**eip) (void), void** esp)
 {
     struct thread* t = thread_current();
     struct Elf32_Ehdr ehdr;
-    struct file* file = NULL;
-    off_t file_ofs;
+    uint8_t *head = NULL;
+    off_t head_size;
+    struct Elf32_Phdr *phdrs, *phdrs_buf = NULL;
+    off_t phdrs_size;
+    struct Elf32_Phdr *loads = NULL;
+    int load_cnt;
     bool success = false;
     int i;
-    char* tmp[2];
-    char prog_name[256];
 
     /* Allocate and activate page directory. */
     t->pagedir = pagedir_create();
     if (t->pagedir == NULL)
         goto done;
-    process_activate();
-
-	func_input_command(file_name, prog_name);
-
-    /* Open executable file. */
-    file = filesys_open(prog_name);
-    if (file == NULL)
+#ifdef VM
+    if (!page_table_init())
     {
-        printf("load: %s: open failed\n", prog_name);
+        pagedir_destroy(t->pagedir);
+        t->pagedir = NULL;
         goto done;
     }
+#endif
+    process_activate();
+    if (!vdso_map())
+        goto done;
+
+    /* Read the executable header and, usually, the program
+       headers with it, in a single read of the start of the
+       file. */
+    head = palloc_get_page(0);
+    if (head == NULL)
+        goto done;
+    head_size = file_read_at(file, head, PGSIZE, 0);
+    if (head_size >= (off_t) sizeof ehdr)
+        memcpy(&ehdr, head, sizeof ehdr);
 
-    /* Read and verify executable header. */
-    if (file_read(file, &ehdr, sizeof ehdr) != sizeof ehdr
+    /* Verify executable header. */
+    if (head_size < (off_t) sizeof ehdr
         || memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7)
         || ehdr.e_type != 2
         || ehdr.e_machine != 3
@@ -247,25 +599,37 @@ load(const char* file_name, void (**eip) (void), void** esp)
         || ehdr.e_phentsize != sizeof(struct Elf32_Phdr)
         || ehdr.e_phnum > 1024)
     {
-        printf("load: %s: error loading executable\n", file_name);
+        conout_flush();
+        printf("load: %s: error loading executable\n", t->name);
         goto done;
     }
 
-    /* Read program headers. */
-    file_ofs = ehdr.e_phoff;
-    for (i = 0; i < ehdr.e_phnum; i++)
+    /* Find the program headers, reading them in one more read if
+       they lie past the first page. */
+    phdrs_size = ehdr.e_phnum * sizeof(struct Elf32_Phdr);
+    if (ehdr.e_phoff <= (Elf32_Off) head_size
+        && phdrs_size <= head_size - ehdr.e_phoff)
+        phdrs = (struct Elf32_Phdr *) (head + ehdr.e_phoff);
+    else
     {
-        struct Elf32_Phdr phdr;
-
-        if (file_ofs < 0 || file_ofs > file_length(file))
+        if (ehdr.e_phoff > (Elf32_Off) file_length(file))
             goto done;
-        file_seek(file, file_ofs);
-
-        if (file_read(file, &phdr, sizeof phdr) != sizeof phdr)
+        phdrs_buf = malloc(phdrs_size);
+        if (phdrs_buf == NULL
+            || file_read_at(file, phdrs_buf, phdrs_size, ehdr.e_phoff)
+               != phdrs_size)
             goto done;
+        phdrs = phdrs_buf;
+    }
 
-        file_ofs += sizeof phdr;
-        switch (phdr.p_type)
+    /* Collect and check the loadable segments. */
+    loads = malloc(ehdr.e_phnum * sizeof *loads);
+    if (loads == NULL && ehdr.e_phnum > 0)
+        goto done;
+    load_cnt = 0;
+    for (i = 0; i < ehdr.e_phnum; i++)
+    {
+        switch (phdrs[i].p_type)
         {
         case PT_NULL:
         case PT_NOTE:
@@ -279,43 +643,50 @@ load(const char* file_name, void (**eip) (void), void** esp)
         case PT_SHLIB:
             goto done;
         case PT_LOAD:
-            if (validate_segment(&phdr, file))
-            {
-                bool writable = (phdr.p_flags & PF_W) != 0;
-                uint32_t file_page = phdr.p_offset & ~PGMASK;
-                uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-                uint32_t page_offset = phdr.p_vaddr & PGMASK;
-                uint32_t read_bytes, zero_bytes;
-                if (phdr.p_filesz > 0)
-                {
-                    /* Normal segment.
-                       Read initial part from disk and zero the rest. */
-                    read_bytes = page_offset + phdr.p_filesz;
-                    zero_bytes = (ROUND_UP(page_offset + phdr.p_memsz, PGSIZE)
-                        - read_bytes);
-                }
-                else
-                {
-                    /* Entirely zero.
-                       Don't read anything from disk. */
-                    read_bytes = 0;
-                    zero_bytes = ROUND_UP(page_offset + phdr.p_memsz, PGSIZE);
-                }
-                if (!load_segment(file, file_page, (void*)mem_page,
-                    read_bytes, zero_bytes, writable))
-                    goto done;
-            }
-            else
+            if (!validate_segment(&phdrs[i], file))
                 goto done;
+            loads[load_cnt++] = phdrs[i];
             break;
         }
     }
+    load_cnt = coalesce_segments(loads, load_cnt);
 
+    for (i = 0; i < load_cnt; i++)
+    {
+        const struct Elf32_Phdr *phdr = &loads[i];
+        bool writable = (phdr->p_flags & PF_W) != 0;
+        uint32_t file_page = phdr->p_offset & ~PGMASK;
+        uint32_t mem_page = phdr->p_vaddr & ~PGMASK;
+        uint32_t page_offset = phdr->p_vaddr & PGMASK;
+        uint32_t read_bytes, zero_bytes;
+        if (phdr->p_filesz > 0)
+        {
+            /* Normal segment.
+               Read initial part from disk and zero the rest. */
+            read_bytes = page_offset + phdr->p_filesz;
+            zero_bytes = (ROUND_UP(page_offset + phdr->p_memsz, PGSIZE)
+                - read_bytes);
+        }
+        else
+        {
+            /* Entirely zero.
+               Don't read anything from disk. */
+            read_bytes = 0;
+            zero_bytes = ROUND_UP(page_offset + phdr->p_memsz, PGSIZE);
+        }
+        if (!load_segment(file, file_page, (void*)mem_page,
+            read_bytes, zero_bytes, writable))
+            goto done;
+    }
 
-    if (!setup_stack(esp))
+    /* Room for the strings, padding, and at worst one argv entry
+       per two bytes of command line, plus argv[argc], argv, argc
+       and the return address. */
+    if (!setup_stack(esp, strlen(file_name) + 1 + 3
+                     + (strlen(file_name) / 2 + 2) * sizeof (char *)
+                     + 3 * sizeof (void *)))
         goto done;
-
-	calculate_esp(file_name, esp);
+    push_args((char *) file_name, esp);
 
     /* Start address. */
     *eip = (void (*) (void)) ehdr.e_entry;
@@ -323,79 +694,28 @@ load(const char* file_name, void (**eip) (void), void** esp)
     success = true;
 
 done:
-    /* We arrive here whether the load is successful or not. */
-    file_close(file);
+    /* We arrive here whether the load is successful or not.
+       On success, keep the executable open and unwritable for as
+       long as the process runs, since its pages may be read from
+       it on demand. */
+    palloc_free_page(head);
+    free(phdrs_buf);
+    free(loads);
+    if (success)
+    {
+        file_deny_write(file);
+        t->exec_file = file;
+    }
+    else
+        file_close(file);
     return success;
 }
 
-void func_input_command(const char* file_name, char* command)
-{
-	char *command_in1, *command_out1;
-	strlcpy(command, file_name, strlen(file_name) + 1);
-	command_in1 = strtok_r(command, " ", &command_out1);
-}
-
-void calculate_esp(const char* file_name, void** esp)
-{
-
-	int argc = 0, length, total_lengh = 0;
-	char command[256];
-	char *cmd_in1, *cmd_out1;
-	int jskim = 4;
-	strlcpy(command, file_name, strlen(file_name) + 1);
-	cmd_in1 = strtok_r(command, " ", &cmd_out1);
-
-	while (cmd_in1 != NULL)
-	{
-		cmd_in1 = strtok_r(NULL, " ", &cmd_out1);
-		argc = argc + 1;
-	}
-
-	char* argv[argc];
-	strlcpy(command, file_name, strlen(file_name) + 1);
-	cmd_in1 = strtok_r(command, " ", &cmd_out1);
-
-	for (int i = 0; i<argc; i++)
-	{
-		if (!cmd_in1) break;
-		argv[i] = cmd_in1;
-		cmd_in1 = strtok_r(NULL, " ", &cmd_out1);
-	}
-
-	for (int j = argc - 1; j >= 0; j--)
-	{
-		length = strlen(argv[j]) + 1;
-		total_lengh = total_lengh + length;
-		*esp -= length;
-		strlcpy(*esp, argv[j], length);
-		argv[j] = *esp;
-	}
-
-	if (total_lengh % 4 != 0)
-		*esp -= 4 - (total_lengh % 4);
-
-	*esp -= 4;
-	**(unsigned**)esp = 0;
-
-	for (int k = argc - 1; k >= 0; k--) {
-		*esp -= 4;
-		**(unsigned int**)esp = (unsigned int)argv[k];
-	}
-
-	// push argv address
-	*esp -= 4;
-	**(unsigned int**)esp = (unsigned int)(*esp) + 4;
-
-	*esp -= 4;
-	**(unsigned int**)esp = argc;
-
-	*esp -= 4;
-	**(unsigned int**)esp = 0;
-}
-
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 
 static bool
@@ -442,6 +762,60 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
 }
 
 
+/* Orders program headers A and B by virtual address, for
+   qsort(). */
+static int
+compare_segments (const void *a_, const void *b_)
+{
+  const struct Elf32_Phdr *a = a_;
+  const struct Elf32_Phdr *b = b_;
+
+  return a->p_vaddr < b->p_vaddr ? -1 : a->p_vaddr > b->p_vaddr;
+}
+
+/* Sorts the CNT validated PT_LOAD program headers in SEGS by
+   address and merges each run of segments that can be loaded as
+   one: same permissions, each starting in or just after the last
+   page of the one before, at the same distance between file
+   offset and address, with no zero fill in between.  Returns the
+   number of segments left in SEGS.
+
+   Fewer, larger segments mean fewer load_segment() calls, each
+   of which reads its file data in one request when it can, and a
+   page shared by the end of one segment and the start of the
+   next is recorded once instead of being rejected the second
+   time.  With VM, pages are still read one at a time as they are
+   first touched. */
+static int
+coalesce_segments (struct Elf32_Phdr *segs, int cnt)
+{
+  int i, n;
+
+  if (cnt == 0)
+    return 0;
+  qsort (segs, cnt, sizeof *segs, compare_segments);
+
+  for (i = 1, n = 0; i < cnt; i++)
+    {
+      struct Elf32_Phdr *prev = &segs[n];
+      const struct Elf32_Phdr *next = &segs[i];
+      Elf32_Addr prev_end = prev->p_vaddr + prev->p_memsz;
+
+      if ((prev->p_flags & PF_W) == (next->p_flags & PF_W)
+          && prev->p_filesz == prev->p_memsz
+          && prev_end <= next->p_vaddr
+          && next->p_vaddr <= ROUND_UP (prev_end, PGSIZE)
+          && next->p_offset - prev->p_offset == next->p_vaddr - prev->p_vaddr)
+        {
+          prev->p_filesz = next->p_vaddr + next->p_filesz - prev->p_vaddr;
+          prev->p_memsz = next->p_vaddr + next->p_memsz - prev->p_vaddr;
+        }
+      else
+        segs[++n] = *next;
+    }
+  return n + 1;
+}
+
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
@@ -450,64 +824,176 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
+#ifdef VM
+  /* Just record where each page comes from.  Pages are read in
+     by page_in() the first time the process touches them. */
   while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
+  /* Read the part of the segment that comes from the file with a
+     single read into contiguous pages, if the user pool has a run
+     that long.  Otherwise, and for the rest, go a page at a time. */
+  size_t run_cnt = DIV_ROUND_UP (read_bytes, PGSIZE);
+  uint8_t *run = run_cnt > 1 ? palloc_get_multiple (PAL_USER, run_cnt) : NULL;
+  size_t i;
+
+  if (run != NULL)
+    {
+      if (file_read_at (file, run, read_bytes, ofs) != (off_t) read_bytes)
+        {
+          palloc_free_multiple (run, run_cnt);
+          return false;
+        }
+      memset (run + read_bytes, 0, run_cnt * PGSIZE - read_bytes);
+    }
+  for (i = 0; read_bytes > 0 || zero_bytes > 0; i++)
     {
       /* Calculate how to fill this page.
          We will read PAGE_READ_BYTES bytes from FILE
          and zero the final PAGE_ZERO_BYTES bytes. */
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      uint8_t *knpage;
 
-      /* Get a page of memory. */
-      uint8_t *knpage = palloc_get_page (PAL_USER);
-      if (knpage == NULL)
-        return false;
-
-      /* Load this page. */
-      if (file_read (file, knpage, page_read_bytes) != (int) page_read_bytes)
+      if (run != NULL && i < run_cnt)
         {
-          palloc_free_page (knpage);
-          return false; 
+          /* Already read. */
+          knpage = run + i * PGSIZE;
+        }
+      else
+        {
+          /* Get a page of memory. */
+          knpage = palloc_get_page (PAL_USER);
+          if (knpage == NULL)
+            return false;
+
+          /* Load this page. */
+          if (file_read_at (file, knpage, page_read_bytes, ofs)
+              != (int) page_read_bytes)
+            {
+              palloc_free_page (knpage);
+              return false; 
+            }
+          memset (knpage + page_read_bytes, 0, page_zero_bytes);
         }
-      memset (knpage + page_read_bytes, 0, page_zero_bytes);
 
       /* Add the page to the process's address space. */
       if (!install_page (upage, knpage, writable)) 
         {
-          palloc_free_page (knpage);
+          if (run != NULL && i < run_cnt)
+            palloc_free_multiple (knpage, run_cnt - i);
+          else
+            palloc_free_page (knpage);
           return false; 
         }
 
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Create a minimal stack by mapping zeroed pages at the top of
+   user virtual memory, enough to hold SIZE bytes of arguments. */
 static bool
-setup_stack (void **esp) 
+setup_stack (void **esp, size_t size) 
 {
-  uint8_t *kpage;
-  bool sunggong = false;
+  bool sunggong = true;
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  size_t i;
 
-  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
-  if (kpage != NULL) 
+  for (i = 1; sunggong && i <= page_cnt; i++)
     {
-	  sunggong = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
-      if (sunggong)
-        *esp = PHYS_BASE;
-      else
+      uint8_t *upage = ((uint8_t *) PHYS_BASE) - i * PGSIZE;
+#ifdef VM
+      /* The arguments are pushed onto these pages right away, so
+         bring them in now rather than on first touch. */
+      sunggong = page_add_zero (upage, true) && page_in (upage, true);
+#else
+      uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+
+      sunggong = kpage != NULL && install_page (upage, kpage, true);
+      if (!sunggong && kpage != NULL)
         palloc_free_page (kpage);
+#endif
     }
+  if (sunggong)
+    *esp = PHYS_BASE;
   return sunggong;
 }
 
+/* Pushes the words of CMD_LINE onto the stack at *ESP as the
+   arguments to main(), in the 80x86 calling convention, and
+   updates *ESP.
 
+   The command line is copied onto the stack in one piece and
+   split into words in place, in a single pass that stores a
+   pointer to each word as it is found.  The pointers are pushed
+   in the order found, just below a null argv[argc], so at the end
+   they are reversed in place to put argv[0] lowest. */
+static void
+push_args (char *cmd_line, void **esp)
+{
+  size_t len = strlen (cmd_line) + 1;
+  char *s = (char *) *esp - len;
+  char **top, **argv, **lo, **hi;
+  uint32_t *sp;
+  int argc = 0;
+  bool in_word = false;
+  char *p;
+
+  memcpy (s, cmd_line, len);
+
+  /* argv[argc], word-aligned below the strings. */
+  top = (char **) ((uintptr_t) s & ~(uintptr_t) 3);
+  *--top = NULL;
+
+  argv = top;
+  for (p = s; *p != '\0'; p++)
+    if (*p == ' ')
+      {
+        *p = '\0';
+        in_word = false;
+      }
+    else if (!in_word)
+      {
+        *--argv = p;
+        argc++;
+        in_word = true;
+      }
+
+  for (lo = argv, hi = top - 1; lo < hi; lo++, hi--)
+    {
+      char *tmp = *lo;
+      *lo = *hi;
+      *hi = tmp;
+    }
+
+  /* argv, argc, and a fake return address. */
+  sp = (uint32_t *) argv;
+  *--sp = (uint32_t) argv;
+  *--sp = argc;
+  *--sp = 0;
+  *esp = sp;
+}
+
+#ifndef VM
 static bool
 install_page (void *upage, void *kpage, bool writable)
 {
@@ -518,4 +1004,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (th->pagedir, upage) == NULL
           && pagedir_set_page (th->pagedir, upage, kpage, writable));
 }
-
+#endif
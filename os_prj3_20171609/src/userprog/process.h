@@ -3,7 +3,14 @@
 
 #include "threads/thread.h"
 
+struct intr_frame;
+
 tid_t process_execute (const char *file_name);
+tid_t process_spawn (const char *cmd_line, const int *fds, size_t fd_cnt,
+                     bool nowait);
+#ifdef VM
+tid_t process_fork (const struct intr_frame *);
+#endif
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -5,118 +5,559 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/process.h"
+#include "userprog/conin.h"
+#include "userprog/conout.h"
+#include "userprog/ioring.h"
+#include "userprog/pipe.h"
+#include "userprog/sysenter.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#endif
 #include "devices/shutdown.h"
-#include "devices/input.h"
 #include "pagedir.h"
 #include "filesys/off_t.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "threads/synch.h"
+#include "threads/palloc.h"
+#include "threads/malloc.h"
 #include <string.h>
 
 static void syscall_handler (struct intr_frame *);
 struct lock lockflag;
 struct lock mutex;
 
+/* A system call handler.  ARG holds the call's arguments, already
+   copied out of the user stack.  The return value is stored in
+   the caller's EAX. */
+typedef uint32_t syscall_func (const uint32_t *arg);
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait;
+static syscall_func sys_create, sys_remove, sys_open, sys_filesize;
+static syscall_func sys_read, sys_write, sys_seek, sys_tell, sys_close;
+static syscall_func sys_fibo, sys_max;
+static syscall_func sys_pread, sys_pwrite, sys_readv, sys_writev;
+static syscall_func sys_io_ring_setup, sys_io_ring_enter;
+static syscall_func sys_spawn, sys_pipe, sys_set_nonblock;
+#ifdef VM
+static syscall_func sys_fork, sys_mmap, sys_munmap;
+static syscall_func sys_madvise, sys_mlock, sys_munlock;
+static syscall_func sys_shm_create, sys_shm_attach, sys_shm_detach;
+#endif
+
+/* Maximum number of arguments taken by any system call. */
+#define SYSCALL_MAX_ARGS 4
+
+/* System call table, indexed by system call number. */
+static const struct syscall
+  {
+    syscall_func *func;         /* Handler, or null if unused. */
+    int argc;                   /* Number of 32-bit arguments. */
+  }
+syscall_table[] =
+  {
+    [SYS_HALT] = {sys_halt, 0},
+    [SYS_EXIT] = {sys_exit, 1},
+    [SYS_EXEC] = {sys_exec, 1},
+    [SYS_WAIT] = {sys_wait, 1},
+    [SYS_CREATE] = {sys_create, 2},
+    [SYS_REMOVE] = {sys_remove, 1},
+    [SYS_OPEN] = {sys_open, 1},
+    [SYS_FILESIZE] = {sys_filesize, 1},
+    [SYS_READ] = {sys_read, 3},
+    [SYS_WRITE] = {sys_write, 3},
+    [SYS_SEEK] = {sys_seek, 2},
+    [SYS_TELL] = {sys_tell, 1},
+    [SYS_CLOSE] = {sys_close, 1},
+    [SYS_FIBO] = {sys_fibo, 1},
+    [SYS_MAX] = {sys_max, 4},
+    [SYS_PREAD] = {sys_pread, 4},
+    [SYS_PWRITE] = {sys_pwrite, 4},
+    [SYS_READV] = {sys_readv, 3},
+    [SYS_WRITEV] = {sys_writev, 3},
+    [SYS_IO_RING_SETUP] = {sys_io_ring_setup, 1},
+    [SYS_IO_RING_ENTER] = {sys_io_ring_enter, 1},
+    [SYS_SPAWN] = {sys_spawn, 4},
+    [SYS_PIPE] = {sys_pipe, 1},
+    [SYS_SET_NONBLOCK] = {sys_set_nonblock, 2},
+#ifdef VM
+    [SYS_FORK] = {sys_fork, 0},
+    [SYS_MMAP] = {sys_mmap, 2},
+    [SYS_MUNMAP] = {sys_munmap, 1},
+    [SYS_MADVISE] = {sys_madvise, 3},
+    [SYS_MLOCK] = {sys_mlock, 2},
+    [SYS_MUNLOCK] = {sys_munlock, 2},
+    [SYS_SHM_CREATE] = {sys_shm_create, 3},
+    [SYS_SHM_ATTACH] = {sys_shm_attach, 2},
+    [SYS_SHM_DETACH] = {sys_shm_detach, 1},
+#endif
+  };
+
+/* Number of entries in syscall_table. */
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
+
 void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  sysenter_init ();
   lock_init(&lockflag);
 }
 
-void check_add(void *address)
+/* User memory access.
+
+   Instead of walking the page table to validate every user
+   pointer, we only check that it lies below PHYS_BASE and then
+   simply dereference it, letting the MMU do the checking.  Each
+   instruction below that may fault on a user address records
+   itself, with the address to resume at, in the .user_fixup
+   section.  If it faults, page_fault() in exception.c finds it
+   there through syscall_fixup(), resumes at the recorded
+   address, and sets EAX to -1 to report the failure.  A kernel
+   fault at any other instruction is a kernel bug.  See [Pintos]
+   3.1.5 "Accessing User Memory". */
+
+/* Records the instruction at local label 1 as one that may
+   fault on a user address, resuming at local label 2. */
+#define USER_FIXUP                              \
+  ".pushsection .user_fixup, \"a\"\n"          \
+  ".balign 4\n"                                 \
+  ".long 1b, 2b\n"                              \
+  ".popsection\n"
+
+/* An entry in the .user_fixup section. */
+struct user_fixup
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t resume;           /* Where to resume if it does. */
+  };
+
+/* Bounds of the .user_fixup section, from kernel.lds.S. */
+extern const struct user_fixup _start_user_fixup[], _end_user_fixup[];
+
+/* Reads a byte at user virtual address UADDR.
+   UADDR must be below PHYS_BASE.
+   Returns the byte value if successful, -1 if a segfault
+   occurred. */
+static inline int
+get_user (const uint8_t *uaddr)
 {
-	struct thread *thrmin = thread_current();
-	if (is_user_vaddr(address) && !is_kernel_vaddr(address) && pagedir_get_page(thrmin->pagedir, address))
-		;
-	else exit(-1);
+  int result;
+  asm ("1: movzbl %1, %0\n2:\n" USER_FIXUP
+       : "=a" (result) : "m" (*uaddr));
+  return result;
 }
 
-void user_input(int cnt, void* args[], void* esp)
+/* Writes BYTE to user address UDST.
+   UDST must be below PHYS_BASE.
+   Returns true if successful, false if a segfault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
 {
-	int operation = 5;
-	for (int i = 0; i< cnt; i++)
-	{
-		args[i] = (void*)((unsigned*)esp + i + 1);
-		check_add(args[i]);
-	}
+  int error_code;
+  asm ("movl $0, %0\n1: movb %b2, %1\n2:\n" USER_FIXUP
+       : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+  return error_code != -1;
+}
+
+/* Reads the 32-bit word at user virtual address UADDR into *DST.
+   Returns true if successful, false if UADDR is not a valid user
+   address. */
+static inline bool
+get_user_word (const uint32_t *uaddr, uint32_t *dst)
+{
+  int error_code;
+  uint32_t word;
+
+  if ((const uint8_t *) uaddr + sizeof *uaddr > (const uint8_t *) PHYS_BASE)
+    return false;
+  asm ("movl $0, %0\n1: movl %2, %1\n2:\n" USER_FIXUP
+       : "=&a" (error_code), "=&r" (word) : "m" (*uaddr));
+  if (error_code == -1)
+    return false;
+  *dst = word;
+  return true;
+}
+
+/* Returns the address at which to resume after a kernel page
+   fault at EIP, or a null pointer if EIP is not one of the user
+   memory accesses above. */
+void *
+syscall_fixup (const void *eip)
+{
+  const struct user_fixup *fx;
+
+  for (fx = _start_user_fixup; fx < _end_user_fixup; fx++)
+    if (fx->insn == (uintptr_t) eip)
+      return (void *) fx->resume;
+  return NULL;
+}
+
+/* Copies the null-terminated string at user address US into a
+   newly allocated page and returns it.  The caller must free
+   the page with palloc_free_page().  Terminates the process if
+   US is invalid or the string, with its null terminator, does
+   not fit in a page, rather than act on a truncated name. */
+char *
+copy_in_string (const char *us)
+{
+  char *ks;
+  size_t length;
+
+  ks = palloc_get_page (0);
+  if (ks == NULL)
+    exit (-1);
+  for (length = 0; length < PGSIZE; length++)
+    {
+      int c;
+
+      if ((const void *) (us + length) >= PHYS_BASE
+          || (c = get_user ((const uint8_t *) us + length)) == -1)
+        {
+          palloc_free_page (ks);
+          exit (-1);
+        }
+      ks[length] = c;
+      if (c == '\0')
+        return ks;
+    }
+  palloc_free_page (ks);
+  exit (-1);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address DST.
+   Each user page touched is validated once, by probing its first
+   byte with get_user(), and the rest of the page is then copied
+   with a single memcpy().  Returns true if successful, false if
+   any part of USRC is not valid user memory. */
+bool
+copy_from_user (void *dst_, const void *usrc_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (usrc);
+      if (chunk > size)
+        chunk = size;
+
+      if (!is_user_vaddr (usrc) || get_user (usrc) == -1)
+        return false;
+      memcpy (dst, usrc, chunk);
+
+      dst += chunk;
+      usrc += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address UDST,
+   validating each user page touched once, by storing its first
+   byte with put_user(), before copying the rest of that page.
+   Returns true if successful, false if any part of UDST is not
+   valid, writable user memory. */
+bool
+copy_to_user (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      if (chunk > size)
+        chunk = size;
+
+      if (!is_user_vaddr (udst) || !put_user (udst, *src))
+        return false;
+      memcpy (udst + 1, src + 1, chunk - 1);
+
+      udst += chunk;
+      src += chunk;
+      size -= chunk;
+    }
+  return true;
+}
+
+/* Returns the file open as FD in the current process.
+   Terminates the process if FD is not open. */
+static struct file *
+fd_to_file (int fd)
+{
+  struct file *file = fd_lookup (&thread_current ()->fds, fd);
+  if (file == NULL)
+    exit (-1);
+  return file;
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
-{
-  void *type = (f->esp);
-  void *args[4];
-
-  switch(*(int*)type){
-  	case SYS_HALT:
-		halt();
-		break;
-	case SYS_EXIT:
-		user_input(1, args, f->esp);
-		exit((int)*(int*)args[0]);
-		break;
-	case SYS_EXEC:
-		user_input(1, args, f->esp);
-		f->eax = exec((char*)*(unsigned*)args[0]);
-		break;
-	case SYS_WAIT:
-		user_input(1, args, f->esp);
-		f->eax = wait((int)*(int*)args[0]);
-		break;
-	case SYS_WRITE:
-		user_input(3, args, f->esp);
-		f->eax = write((int)*(int*)args[0], (void*)*(int*)args[1], (size_t)*(int*)args[2]);
-		break;
-	case SYS_READ:
-		user_input(3, args, f->esp);
-		f->eax = read((int)*(int*)args[0], (void*)*(int*)args[1], (size_t)*(int*)args[2]);
-  		break;
-	case SYS_FIBO:
-		user_input(1, args, f->esp);
-		f->eax = fibonacci((int)*(int*)args[0]);
-		break;
-	case SYS_MAX:
-		user_input(4, args, f->esp);
-		f->eax = max_of_four_int((int)*(int*)args[0], (int)*(int*)args[1], (int)*(int*)args[2], (int)*(int*)args[3]);
-		break;
-	case SYS_CREATE:
-		user_input(2, args, f->esp);
-		f->eax = create((const char*)*(unsigned*)args[0], (unsigned)*(unsigned*)args[1]);
- 		break;
-	case SYS_REMOVE:
-		user_input(1, args, f->esp);
-		f->eax = remove((const char*)*(unsigned*)args[0]);
-		break;
-	case SYS_OPEN:
-		user_input(1, args, f->esp);
-		f->eax = open((const char*)*(unsigned*)args[0]);
-		break;
-	case SYS_CLOSE:
-		user_input(1, args, f->esp);
-		close((int)*(int*)args[0]);
-		break;
-	case SYS_FILESIZE:
-		user_input(1, args, f->esp);
-		f->eax = filesize((int)*(int*)args[0]);
-		break;
-	case SYS_SEEK:
-		user_input(2, args, f->esp);
-		seek((int)*(int*)args[0], (unsigned)*(unsigned*)args[1]);
-		break;
-	case SYS_TELL:
-		user_input(1, args, f->esp);
-		f->eax = tell((int)*(int*)args[0]);
-		break;
-	default:
-		break;
-  }
+syscall_handler (struct intr_frame *f) 
+{
+  const struct syscall *sc;
+  uint32_t arg[SYSCALL_MAX_ARGS];
+  uint32_t nr;
+  int i;
+
+#ifdef VM
+  /* Page faults taken while copying to or from the user stack
+     need the user's stack pointer to tell stack growth from a bad
+     access, and fork() needs the whole user context. */
+  thread_current ()->user_if = f;
+#endif
+  if (!get_user_word (f->esp, &nr))
+    exit (-1);
+  if (nr >= SYSCALL_CNT || syscall_table[nr].func == NULL)
+    return;
+
+  sc = syscall_table + nr;
+  for (i = 0; i < sc->argc; i++)
+    if (!get_user_word ((uint32_t *) f->esp + i + 1, &arg[i]))
+      exit (-1);
+  f->eax = sc->func (arg);
+}
+
+/* Handles a system call made with SYSENTER.  Called by
+   sysenter_entry in sysenter.S, with F built to look just like the
+   frame of an INT $0x30. */
+void
+syscall_sysenter (struct intr_frame *f)
+{
+  syscall_handler (f);
+}
+
+/* System call wrappers.  Each one unpacks ARG and calls the
+   implementation below. */
+
+static uint32_t
+sys_halt (const uint32_t *arg UNUSED)
+{
+  halt ();
+  NOT_REACHED ();
+}
+
+static uint32_t
+sys_exit (const uint32_t *arg)
+{
+  exit ((int) arg[0]);
+}
+
+static uint32_t
+sys_exec (const uint32_t *arg)
+{
+  char *cmd_line = copy_in_string ((const char *) arg[0]);
+  pid_t pid = exec (cmd_line);
+  palloc_free_page (cmd_line);
+  return pid;
+}
+
+static uint32_t
+sys_spawn (const uint32_t *arg)
+{
+  char *cmd_line = copy_in_string ((const char *) arg[0]);
+  pid_t pid = spawn (cmd_line, (const int *) arg[1], (int) arg[2],
+                     (int) arg[3]);
+  palloc_free_page (cmd_line);
+  return pid;
+}
+
+static uint32_t
+sys_wait (const uint32_t *arg)
+{
+  return wait ((pid_t) arg[0]);
+}
+
+static uint32_t
+sys_create (const uint32_t *arg)
+{
+  char *file = copy_in_string ((const char *) arg[0]);
+  bool success = create (file, (unsigned) arg[1]);
+  palloc_free_page (file);
+  return success;
+}
+
+static uint32_t
+sys_remove (const uint32_t *arg)
+{
+  char *file = copy_in_string ((const char *) arg[0]);
+  bool success = remove (file);
+  palloc_free_page (file);
+  return success;
+}
+
+static uint32_t
+sys_open (const uint32_t *arg)
+{
+  char *file = copy_in_string ((const char *) arg[0]);
+  int fd = open (file);
+  palloc_free_page (file);
+  return fd;
+}
+
+static uint32_t
+sys_filesize (const uint32_t *arg)
+{
+  return filesize ((int) arg[0]);
+}
+
+static uint32_t
+sys_read (const uint32_t *arg)
+{
+  return read ((int) arg[0], (void *) arg[1], (unsigned) arg[2]);
+}
+
+static uint32_t
+sys_write (const uint32_t *arg)
+{
+  return write ((int) arg[0], (const void *) arg[1], (unsigned) arg[2]);
+}
+
+static uint32_t
+sys_pread (const uint32_t *arg)
+{
+  return pread ((int) arg[0], (void *) arg[1], (unsigned) arg[2],
+                (unsigned) arg[3]);
+}
+
+static uint32_t
+sys_pwrite (const uint32_t *arg)
+{
+  return pwrite ((int) arg[0], (const void *) arg[1], (unsigned) arg[2],
+                 (unsigned) arg[3]);
+}
+
+static uint32_t
+sys_readv (const uint32_t *arg)
+{
+  return readv ((int) arg[0], (const struct iovec *) arg[1], (int) arg[2]);
+}
+
+static uint32_t
+sys_writev (const uint32_t *arg)
+{
+  return writev ((int) arg[0], (const struct iovec *) arg[1], (int) arg[2]);
+}
+
+static uint32_t
+sys_pipe (const uint32_t *arg)
+{
+  return pipe ((int *) arg[0]);
+}
+
+static uint32_t
+sys_set_nonblock (const uint32_t *arg)
+{
+  return set_nonblock ((int) arg[0], (bool) arg[1]);
+}
+
+static uint32_t
+sys_io_ring_setup (const uint32_t *arg)
+{
+  return io_ring_setup ((void *) arg[0]);
+}
+
+static uint32_t
+sys_io_ring_enter (const uint32_t *arg)
+{
+  return io_ring_enter ((unsigned) arg[0]);
+}
+
+#ifdef VM
+static uint32_t
+sys_fork (const uint32_t *arg UNUSED)
+{
+  return fork ();
+}
+
+static uint32_t
+sys_mmap (const uint32_t *arg)
+{
+  return mmap ((int) arg[0], (void *) arg[1]);
+}
+
+static uint32_t
+sys_munmap (const uint32_t *arg)
+{
+  munmap ((mapid_t) arg[0]);
+  return 0;
+}
+
+static uint32_t
+sys_madvise (const uint32_t *arg)
+{
+  return madvise ((void *) arg[0], (size_t) arg[1], (int) arg[2]);
+}
+
+static uint32_t
+sys_mlock (const uint32_t *arg)
+{
+  return mlock ((const void *) arg[0], (size_t) arg[1]);
+}
+
+static uint32_t
+sys_munlock (const uint32_t *arg)
+{
+  return munlock ((const void *) arg[0], (size_t) arg[1]);
+}
+
+static uint32_t
+sys_shm_create (const uint32_t *arg)
+{
+  return shm_create ((int) arg[0], (size_t) arg[1], (void *) arg[2]);
+}
+
+static uint32_t
+sys_shm_attach (const uint32_t *arg)
+{
+  return shm_attach ((int) arg[0], (void *) arg[1]);
+}
 
+static uint32_t
+sys_shm_detach (const uint32_t *arg)
+{
+  return shm_detach ((void *) arg[0]);
+}
+#endif
+
+static uint32_t
+sys_seek (const uint32_t *arg)
+{
+  seek ((int) arg[0], (unsigned) arg[1]);
+  return 0;
+}
+
+static uint32_t
+sys_tell (const uint32_t *arg)
+{
+  return tell ((int) arg[0]);
+}
+
+static uint32_t
+sys_close (const uint32_t *arg)
+{
+  close ((int) arg[0]);
+  return 0;
+}
+
+static uint32_t
+sys_fibo (const uint32_t *arg)
+{
+  return fibonacci ((int) arg[0]);
+}
+
+static uint32_t
+sys_max (const uint32_t *arg)
+{
+  return max_of_four_int ((int) arg[0], (int) arg[1],
+                          (int) arg[2], (int) arg[3]);
 }
 
 void halt()
 {
+	conout_flush();
 	shutdown_power_off();
 }
 
@@ -124,12 +565,8 @@ void exit(int status)
 {
 	struct thread* cur = thread_current();
 	cur->exit_status = status;
+	conout_flush();
 	printf("%s: exit(%d)\n", thread_name(), status);
-	
-	for(int i=3; i<128; i++)
-	{
-		if(cur->fd[i] != NULL) close(i);
-	}
 	thread_exit();
 }
 
@@ -138,71 +575,293 @@ pid_t exec(const char* cmd_line)
 	return process_execute(cmd_line);
 }
 
+/* Starts CMD_LINE as a child process that inherits the FD_CNT
+   descriptors in user array FDS as its descriptors 3, 4, and so
+   on.  With SPAWN_NOWAIT in FLAGS, returns without waiting for the
+   child to load, and a failed load shows up as an exit status of
+   -1 from wait(). */
+pid_t spawn(const char* cmd_line, const int* fds, int fd_cnt, int flags)
+{
+	int kfds[SPAWN_FDS_MAX];
+
+	if (fd_cnt < 0 || fd_cnt > SPAWN_FDS_MAX
+	    || (flags & ~SPAWN_NOWAIT) != 0)
+		return -1;
+	if (!copy_from_user(kfds, fds, fd_cnt * sizeof *kfds))
+		exit(-1);
+	return process_spawn(cmd_line, kfds, fd_cnt,
+	                     (flags & SPAWN_NOWAIT) != 0);
+}
+
 int wait(pid_t pid)
 {
 	return process_wait(pid);
 }
 
-int write(int fd, const void* buffer, unsigned size)
+/* Writes the buffers in IOV[0...IOVCNT-1], which are in user
+   memory, to FD.  If OFS is null, writes at the file's current
+   position and advances it; otherwise writes at offset *OFS and
+   advances *OFS instead.  Data is copied in through a kernel page
+   one page at a time, with the file system lock held only while
+   writing to a file; pipes and the console, which is buffered by
+   conout_write(), do not take it at all.  Returns the
+   number of bytes written, or -1 on error.  Terminates the
+   process if FD is not open or a buffer is invalid. */
+static int
+do_writev (int fd, const struct iovec *iov, int iovcnt, off_t *ofs)
 {
-	struct thread *thread_cur = thread_current();
-	int file_wir;
+  struct file *file = NULL;
+  struct pipe *pipe = NULL;
+  uint8_t *kbuf;
+  int done = 0;
+  int i;
 
-	check_add(buffer);
-	lock_acquire(&lockflag);
+  if (fd != 1)
+    {
+      bool write_end;
 
-	if(fd == 1)
-	{
-		putbuf((char*)buffer, size);
-		lock_release(&lockflag);
-		return size;
-	}
-	else
-	{
-		if(thread_cur->fd[fd] == NULL)
-		{
-			lock_release(&lockflag);
-			exit(-1);
-		}
-		file_wir = file_write(thread_cur->fd[fd], buffer, size);
-		lock_release(&lockflag);
-		return file_wir;
-	}
-	lock_release(&lockflag);
-	return -1;
+      pipe = fd_lookup_pipe (&thread_current ()->fds, fd, &write_end);
+      if (pipe == NULL)
+        file = fd_to_file (fd);
+      else if (!write_end || ofs != NULL)
+        return -1;
+    }
+  else if (ofs != NULL)
+    return -1;
+
+  kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      const uint8_t *buffer = iov[i].iov_base;
+      size_t pos;
+
+      for (pos = 0; pos < iov[i].iov_len; )
+        {
+          size_t left = iov[i].iov_len - pos;
+          off_t chunk = left < PGSIZE ? left : PGSIZE;
+          off_t written;
+
+          if (!copy_from_user (kbuf, buffer + pos, chunk))
+            {
+              palloc_free_page (kbuf);
+              exit (-1);
+            }
+
+          if (pipe != NULL)
+            {
+              written = pipe_write (pipe, kbuf, chunk);
+              if (written < 0)
+                {
+                  palloc_free_page (kbuf);
+                  return done > 0 ? done : -1;
+                }
+            }
+          else if (file == NULL)
+            {
+              conout_write (kbuf, chunk);
+              written = chunk;
+            }
+          else
+            {
+              lock_acquire (&lockflag);
+              if (ofs != NULL)
+                {
+                  written = file_write_at (file, kbuf, chunk, *ofs);
+                  *ofs += written;
+                }
+              else
+                written = file_write (file, kbuf, chunk);
+              lock_release (&lockflag);
+            }
+
+          pos += written;
+          done += written;
+          if (written < chunk)
+            goto out;
+        }
+    }
+
+ out:
+  palloc_free_page (kbuf);
+  return done;
+}
+
+/* Reads from FD into the buffers in IOV[0...IOVCNT-1], which are
+   in user memory.  If OFS is null, reads at the file's current
+   position and advances it; otherwise reads at offset *OFS and
+   advances *OFS instead.  Data is read into a kernel page one
+   page at a time and copied out after dropping the file system
+   lock, which pipes and the console, buffered by conin_read(),
+   do not take at all.  A read from a pipe or the console only
+   waits for data if nothing has been read yet and FD is not
+   non-blocking, and a console read stops after a line.  Returns
+   the number of bytes read, or -1 on error, including a
+   non-blocking read from a pipe or the console with nothing to
+   read yet.  Terminates the process if FD is not open or a buffer
+   is invalid. */
+static int
+do_readv (int fd, const struct iovec *iov, int iovcnt, off_t *ofs)
+{
+  struct file *file = NULL;
+  struct pipe *pipe = NULL;
+  bool block = !fd_is_nonblock (&thread_current ()->fds, fd);
+  uint8_t *kbuf;
+  int done = 0;
+  int i;
+
+  if (fd != 0)
+    {
+      bool write_end;
+
+      pipe = fd_lookup_pipe (&thread_current ()->fds, fd, &write_end);
+      if (pipe == NULL)
+        file = fd_to_file (fd);
+      else if (write_end || ofs != NULL)
+        return -1;
+    }
+  else if (ofs != NULL)
+    return -1;
+
+  kbuf = palloc_get_page (0);
+  if (kbuf == NULL)
+    return -1;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      uint8_t *buffer = iov[i].iov_base;
+      size_t pos;
+
+      for (pos = 0; pos < iov[i].iov_len; )
+        {
+          size_t left = iov[i].iov_len - pos;
+          off_t chunk = left < PGSIZE ? left : PGSIZE;
+          off_t got;
+
+          if (file == NULL)
+            {
+              if (pipe != NULL)
+                got = pipe_read (pipe, kbuf, chunk, block && done == 0);
+              else
+                got = conin_read (kbuf, chunk, block && done == 0);
+              if (got < 0)
+                {
+                  /* Empty, and not at end of file. */
+                  if (done == 0)
+                    done = -1;
+                  goto out;
+                }
+            }
+          else
+            {
+              lock_acquire (&lockflag);
+              if (ofs != NULL)
+                {
+                  got = file_read_at (file, kbuf, chunk, *ofs);
+                  *ofs += got;
+                }
+              else
+                got = file_read (file, kbuf, chunk);
+              lock_release (&lockflag);
+            }
+
+          if (!copy_to_user (buffer + pos, kbuf, got))
+            {
+              palloc_free_page (kbuf);
+              exit (-1);
+            }
+
+          pos += got;
+          done += got;
+          if (got < chunk)
+            goto out;
+        }
+    }
+
+ out:
+  palloc_free_page (kbuf);
+  return done;
+}
+
+/* Copies the IOVCNT-element iovec array at user address UIOV
+   into a newly allocated kernel array, which the caller must
+   free.  Returns a null pointer if IOVCNT is out of range or
+   memory is exhausted.  Terminates the process if UIOV is
+   invalid. */
+static struct iovec *
+copy_in_iovec (const struct iovec *uiov, int iovcnt)
+{
+  struct iovec *iov;
+
+  if (iovcnt <= 0 || iovcnt > IOV_MAX)
+    return NULL;
+  iov = malloc (iovcnt * sizeof *iov);
+  if (iov == NULL)
+    return NULL;
+  if (!copy_from_user (iov, uiov, iovcnt * sizeof *iov))
+    {
+      free (iov);
+      exit (-1);
+    }
+  return iov;
+}
+
+int write(int fd, const void* buffer, unsigned size)
+{
+	struct iovec iov = {(void*)buffer, size};
+	return do_writev(fd, &iov, 1, NULL);
 }
 
 int read(int fd, void* buffer, unsigned size)
 {
-	int file_wir;
-	struct thread *thread_cur = thread_current();
-	
-	check_add(buffer);
-	lock_acquire(&lockflag);
-	
-	if(fd == 0)
-	{
-		for (unsigned int i = 0; i < size; i++)
-		{
-			((char*)buffer)[i] = (char)input_getc();
-		}
-		lock_release(&lockflag);
-		return size;
-	}
-	else
-	{
-		if(thread_cur->fd[fd] == NULL)
-		{
-			lock_release(&lockflag);
-			exit(-1);
-		}
-		file_wir = file_read(thread_cur->fd[fd], buffer, size);
-		lock_release(&lockflag);
-		return file_wir;
-	}
-	
-	lock_release(&lockflag);
-	return -1;
+	struct iovec iov = {buffer, size};
+	return do_readv(fd, &iov, 1, NULL);
+}
+
+int pwrite(int fd, const void* buffer, unsigned size, unsigned offset)
+{
+	struct iovec iov = {(void*)buffer, size};
+	off_t ofs = offset;
+
+	if (ofs < 0)
+		return -1;
+	return do_writev(fd, &iov, 1, &ofs);
+}
+
+int pread(int fd, void* buffer, unsigned size, unsigned offset)
+{
+	struct iovec iov = {buffer, size};
+	off_t ofs = offset;
+
+	if (ofs < 0)
+		return -1;
+	return do_readv(fd, &iov, 1, &ofs);
+}
+
+int writev(int fd, const struct iovec* iov, int iovcnt)
+{
+	struct iovec *kiov = copy_in_iovec(iov, iovcnt);
+	int written;
+
+	if (kiov == NULL)
+		return -1;
+	written = do_writev(fd, kiov, iovcnt, NULL);
+	free(kiov);
+	return written;
+}
+
+int readv(int fd, const struct iovec* iov, int iovcnt)
+{
+	struct iovec *kiov = copy_in_iovec(iov, iovcnt);
+	int got;
+
+	if (kiov == NULL)
+		return -1;
+	got = do_readv(fd, kiov, iovcnt, NULL);
+	free(kiov);
+	return got;
 }
 
 int fibonacci(int n)
@@ -249,58 +908,143 @@ int open(const char* file)
 {
 	struct thread *cur = thread_current();
 	struct file* filest;
-	int state = -1, fd;
+	int fd;
 
 	if(file==NULL)
 		exit(-1);
 
 	lock_acquire(&lockflag);
 	filest = filesys_open(file);
-
-	if (filest)
+	if (filest == NULL)
 	{
-		for (int i = 3; i < 128; i++)
-		{
-			if (cur->fd[i] == NULL)
-			{
-				if (!strcmp(cur->name, file))
-					file_deny_write(filest);
-				cur->fd[i] = filest;
-				state = i;
-				break;
-			}
-		}
+		lock_release(&lockflag);
+		return -1;
 	}
-	else
-		state = -1;
+
+	if (!strcmp(cur->name, file))
+		file_deny_write(filest);
+	fd = fd_alloc(&cur->fds, filest);
+	if (fd < 0)
+		file_close(filest);
 
 	lock_release(&lockflag);
-	return state;
+	return fd;
 }
 
 void close(int fd) {
-	struct file *curfd = thread_current()->fd[fd];
+	if (!fd_close(&thread_current()->fds, fd))
+		exit(-1);
+}
+
+/* Creates a pipe and stores descriptors for its read end and its
+   write end in user array FDS[0] and FDS[1].  Returns 0 if
+   successful, -1 if memory or descriptors are exhausted. */
+int pipe(int *fds)
+{
+	struct fd_table *t = &thread_current()->fds;
+	struct pipe *p;
+	int kfds[2];
 
-	if (curfd == NULL)
+	p = pipe_create();
+	if (p == NULL)
+		return -1;
+	kfds[0] = fd_alloc_pipe(t, p, false);
+	if (kfds[0] < 0)
+		pipe_close(p, false);
+	kfds[1] = fd_alloc_pipe(t, p, true);
+	if (kfds[1] < 0)
+		pipe_close(p, true);
+	if (kfds[0] < 0 || kfds[1] < 0) {
+		if (kfds[0] >= 0)
+			fd_close(t, kfds[0]);
+		if (kfds[1] >= 0)
+			fd_close(t, kfds[1]);
+		return -1;
+	}
+	if (!copy_to_user(fds, kfds, sizeof kfds))
 		exit(-1);
-	thread_current()->fd[fd] = NULL;
-	file_close(curfd);
+	return 0;
+}
+
+/* Makes reads from FD return at once, instead of waiting, when
+   no data is available, if NONBLOCK is true, or wait again if it
+   is false.  Such a read from an empty pipe or console returns
+   -1, so that it is not mistaken for end of file, which still
+   returns 0.
+   Returns 0 if successful, -1 if FD is not open. */
+int set_nonblock(int fd, bool nonblock)
+{
+	return fd_set_nonblock(&thread_current()->fds, fd, nonblock) ? 0 : -1;
 }
 
 int filesize(int fd)
 {
-	struct thread *cur = thread_current();
-	return file_length(cur->fd[fd]);
+	return file_length(fd_to_file(fd));
 }
 
 void seek(int fd, unsigned position)
 {
-	struct thread *cur = thread_current();
-	file_seek(cur->fd[fd], position);
+	file_seek(fd_to_file(fd), position);
 }
 
 unsigned tell(int fd)
 {
-	struct thread *cur = thread_current();
-	return file_tell(cur->fd[fd]);
+	return file_tell(fd_to_file(fd));
+}
+
+#ifdef VM
+pid_t fork(void)
+{
+	return process_fork(thread_current()->user_if);
+}
+
+mapid_t mmap(int fd, void *addr)
+{
+	struct file *file = fd_lookup(&thread_current()->fds, fd);
+
+	if (file == NULL)
+		return MAP_FAILED;
+	return mmap_map(file, addr);
+}
+
+void munmap(mapid_t mapping)
+{
+	mmap_unmap(mapping);
+}
+
+int madvise(void *addr, size_t length, int advice)
+{
+	return page_advise(addr, length, advice) ? 0 : -1;
+}
+
+int mlock(const void *addr, size_t length)
+{
+	return page_lock_range(addr, length, true) ? 0 : -1;
+}
+
+int munlock(const void *addr, size_t length)
+{
+	return page_lock_range(addr, length, false) ? 0 : -1;
+}
+
+/* Creates shared memory segment KEY, SIZE bytes long, and
+   attaches it at ADDR.  Returns 0 if successful, -1 otherwise. */
+int shm_create(int key, size_t size, void *addr)
+{
+	return shm_new(key, size, addr) ? 0 : -1;
+}
+
+/* Attaches shared memory segment KEY at ADDR.  Returns the
+   segment's size in bytes, or -1 on failure. */
+int shm_attach(int key, void *addr)
+{
+	size_t size = shm_map(key, addr);
+
+	return size > 0 ? (int) size : -1;
+}
+
+int shm_detach(void *addr)
+{
+	return shm_unmap(addr) ? 0 : -1;
 }
+#endif
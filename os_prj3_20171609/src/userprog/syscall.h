@@ -1,24 +1,87 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+#include <debug.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include "threads/synch.h"
 
 typedef int pid_t;
 
+/* Memory-mapped file identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* System call numbers for calls that are not in <syscall-nr.h>.
+   They start well past its last entry, so that calls added there
+   cannot collide with them. */
+enum
+  {
+    SYS_PREAD = 64,             /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_IO_RING_SETUP,          /* Map a submission/completion ring. */
+    SYS_IO_RING_ENTER,          /* Run queued ring operations. */
+    SYS_FORK,                   /* Duplicate the current process. */
+    SYS_MADVISE,                /* Give paging advice. */
+    SYS_MLOCK,                  /* Lock pages in memory. */
+    SYS_MUNLOCK,                /* Unlock pages. */
+    SYS_SPAWN,                  /* Start a process with given fds. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_SHM_CREATE,             /* Create a shared memory segment. */
+    SYS_SHM_ATTACH,             /* Attach a shared memory segment. */
+    SYS_SHM_DETACH,             /* Detach a shared memory segment. */
+    SYS_SET_NONBLOCK            /* Make reads from an fd not wait. */
+  };
+
+/* Advice for madvise(). */
+#define MADV_NORMAL     0       /* No special treatment. */
+#define MADV_RANDOM     1       /* Expect random access: no read-ahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access. */
+#define MADV_WILLNEED   3       /* Will need these pages soon. */
+#define MADV_DONTNEED   4       /* Won't need these pages soon. */
+
+/* Flags for spawn(). */
+#define SPAWN_NOWAIT 1          /* Return before the child loads. */
+
+/* Maximum number of descriptors passed to spawn(). */
+#define SPAWN_FDS_MAX 16
+
+/* One buffer of a readv() or writev() call. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Length of buffer in bytes. */
+  };
+
+/* Maximum number of buffers in a readv() or writev() call. */
+#define IOV_MAX 1024
+
+/* Serializes all file system access. */
+extern struct lock lockflag;
+
 void syscall_init (void);
+void *syscall_fixup (const void *eip);
 
 void halt(void);
-void exit(int status);
+void exit(int status) NO_RETURN;
 pid_t exec(const char *cmd_line);
+pid_t spawn(const char *cmd_line, const int *fds, int fd_cnt, int flags);
 int wait(pid_t pid);
 int write(int fd, const void *buffer, unsigned size);
 int read(int fd, void *buffer, unsigned size);
+int pread(int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite(int fd, const void *buffer, unsigned size, unsigned offset);
+int readv(int fd, const struct iovec *iov, int iovcnt);
+int writev(int fd, const struct iovec *iov, int iovcnt);
 
 int fibonacci(int n);
 int max_of_four_int(int a, int b, int c, int d);
 
-void check_add(void *address);
-void user_input(int count, void *args[], void* esp);
+char *copy_in_string(const char *us);
+bool copy_from_user(void *dst, const void *usrc, size_t size);
+bool copy_to_user(void *udst, const void *src, size_t size);
 
 bool create(const char *file, unsigned initial_size);
 bool remove(const char *file);
@@ -27,5 +90,19 @@ int filesize(int fd);
 void seek(int fd, unsigned position);
 unsigned tell(int fd);
 void close(int fd);
+int pipe(int *fds);
+int set_nonblock(int fd, bool nonblock);
+
+#ifdef VM
+pid_t fork(void);
+mapid_t mmap(int fd, void *addr);
+void munmap(mapid_t mapping);
+int madvise(void *addr, size_t length, int advice);
+int mlock(const void *addr, size_t length);
+int munlock(const void *addr, size_t length);
+int shm_create(int key, size_t size, void *addr);
+int shm_attach(int key, void *addr);
+int shm_detach(void *addr);
+#endif
 
 #endif /* userprog/syscall.h */
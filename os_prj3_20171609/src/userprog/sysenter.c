@@ -0,0 +1,66 @@
+#include "userprog/sysenter.h"
+#include <debug.h>
+#include "threads/loader.h"
+#include "userprog/tss.h"
+
+/* Entry point, in sysenter.S. */
+void sysenter_entry (void);
+
+/* True once the SYSENTER MSRs are set up. */
+static bool enabled;
+
+static bool cpu_has_sysenter (void);
+static inline void wrmsr (uint32_t msr, uint32_t value);
+
+/* Sets up SYSENTER, if the CPU supports it.  Otherwise
+   MSR_SYSENTER_CS stays 0, so SYSENTER raises a general
+   protection fault, which kills the process like any other bad
+   instruction, and INT $0x30 remains the only way in.  Must be
+   called after tss_init().
+
+   MSR_SYSENTER_ESP points at the TSS's ring 0 stack pointer, not
+   at a stack, and sysenter_entry loads the real stack from there.
+   So the MSR is written once here, rather than on every thread
+   switch, and tss_update() alone keeps both ways in current. */
+void
+sysenter_init (void)
+{
+  if (!cpu_has_sysenter ())
+    return;
+
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_ESP, (uint32_t) tss_get_esp0 ());
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+  enabled = true;
+}
+
+/* Returns true if SYSENTER has been set up, false if processes
+   must use INT $0x30. */
+bool
+sysenter_enabled (void)
+{
+  return enabled;
+}
+
+/* Returns true if the CPU implements SYSENTER and SYSEXIT.  The
+   original Pentium Pro claims to, but does not. */
+static bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  uint32_t family, model, stepping;
+
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return ((edx & (1 << 11)) != 0
+          && !(family == 6 && model < 3 && stepping < 3));
+}
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
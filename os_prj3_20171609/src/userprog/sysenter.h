@@ -0,0 +1,39 @@
+#ifndef USERPROG_SYSENTER_H
+#define USERPROG_SYSENTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Fast system calls with SYSENTER/SYSEXIT.
+
+   On CPUs that have them, a process may enter the kernel with
+   SYSENTER instead of INT $0x30.  The arguments are laid out on
+   the user stack exactly as for INT $0x30, system call number
+   first, and the call is made with ECX holding the user stack
+   pointer and EDX the address to return to:
+
+        pushl <args...>
+        pushl $SYS_<NR>
+        movl %esp, %ecx
+        movl $1f, %edx
+        sysenter
+     1: addl $<4 * (argc + 1)>, %esp
+
+   The result comes back in EAX, as usual.  ECX, EDX and the
+   arithmetic flags are not preserved.  Processes need not know
+   whether the CPU supports SYSENTER: the vDSO page's syscall,
+   read and write functions use it when it is set up and
+   INT $0x30 otherwise. */
+
+/* Model-specific registers that configure SYSENTER. */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code segment. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+struct intr_frame;
+
+void sysenter_init (void);
+bool sysenter_enabled (void);
+void syscall_sysenter (struct intr_frame *);
+
+#endif /* userprog/sysenter.h */
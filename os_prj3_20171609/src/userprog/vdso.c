@@ -0,0 +1,154 @@
+#include "userprog/vdso.h"
+#include <debug.h>
+#include <stddef.h>
+#include <string.h>
+#include <syscall-nr.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/sysenter.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#endif
+
+/* Code copied into the page, in vdso.S. */
+extern const char vdso_text[], vdso_text_end[];
+extern const char vdso_get_ticks[], vdso_get_tid[], vdso_get_load_avg[];
+extern const char vdso_fibonacci[], vdso_max_of_four_int[];
+extern const char vdso_syscall_sysenter[], vdso_read_sysenter[];
+extern const char vdso_write_sysenter[];
+extern const char vdso_syscall_int[], vdso_read_int[], vdso_write_int[];
+
+/* The vDSO page, at its kernel address. */
+static struct vdso_page *vdso;
+#ifdef VM
+/* Wired frame holding VDSO, which is mapped through the
+   supplemental page table like any other page. */
+static struct frame *vdso_frame;
+#endif
+
+static void *user_addr (const char *);
+
+/* Sets up the vDSO page.  Must be called after syscall_init()
+   and, under VM, after frame_init(). */
+void
+vdso_init (void)
+{
+  size_t text_size = vdso_text_end - vdso_text;
+
+  ASSERT (offsetof (struct vdso_page, seq) == VDSO_SEQ);
+  ASSERT (offsetof (struct vdso_page, ticks) == VDSO_TICKS);
+  ASSERT (offsetof (struct vdso_page, tid) == VDSO_TID);
+  ASSERT (offsetof (struct vdso_page, load_avg) == VDSO_LOAD_AVG);
+  ASSERT (VDSO_SYS_READ == SYS_READ && VDSO_SYS_WRITE == SYS_WRITE);
+  ASSERT (sizeof *vdso <= VDSO_TEXT_OFS);
+  ASSERT (VDSO_TEXT_OFS + text_size <= PGSIZE);
+
+#ifdef VM
+  lock_acquire (&frame_lock);
+  vdso_frame = frame_alloc_wired ();
+  lock_release (&frame_lock);
+  if (vdso_frame == NULL)
+    PANIC ("vdso: page allocation failed");
+  vdso = vdso_frame->kpage;
+#else
+  vdso = palloc_get_page (PAL_ZERO);
+  if (vdso == NULL)
+    PANIC ("vdso: page allocation failed");
+#endif
+
+  memcpy ((char *) vdso + VDSO_TEXT_OFS, vdso_text, text_size);
+  vdso->get_ticks = user_addr (vdso_get_ticks);
+  vdso->get_tid = user_addr (vdso_get_tid);
+  vdso->get_load_avg = user_addr (vdso_get_load_avg);
+  vdso->fibonacci = user_addr (vdso_fibonacci);
+  vdso->max_of_four_int = user_addr (vdso_max_of_four_int);
+  if (sysenter_enabled ())
+    {
+      vdso->syscall = user_addr (vdso_syscall_sysenter);
+      vdso->read = user_addr (vdso_read_sysenter);
+      vdso->write = user_addr (vdso_write_sysenter);
+    }
+  else
+    {
+      vdso->syscall = user_addr (vdso_syscall_int);
+      vdso->read = user_addr (vdso_read_int);
+      vdso->write = user_addr (vdso_write_int);
+    }
+  vdso->ticks = timer_ticks ();
+}
+
+/* Returns the user address at which SYM, in vdso.S, appears in
+   the vDSO page. */
+static void *
+user_addr (const char *sym)
+{
+  return (char *) VDSO_BASE + VDSO_TEXT_OFS + (sym - vdso_text);
+}
+
+/* Maps the vDSO page, read-only, into the current process.
+   Returns true if successful, false if VDSO_BASE is already in
+   use or memory is exhausted. */
+bool
+vdso_map (void)
+{
+  void *upage = (void *) VDSO_BASE;
+
+#ifdef VM
+  return page_add_wired (upage, vdso_frame, false);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+
+  return (pagedir_get_page (pd, upage) == NULL
+          && pagedir_set_page (pd, upage, vdso, false));
+#endif
+}
+
+/* Unmaps the vDSO page from the current process, if it is mapped
+   there.  Must be called before the process's page directory is
+   destroyed, which would otherwise free the page. */
+void
+vdso_unmap (void)
+{
+  void *upage = (void *) VDSO_BASE;
+
+#ifdef VM
+  struct page *p = page_lookup (upage);
+
+  if (p != NULL && p->frame == vdso_frame)
+    page_remove (upage);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+
+  if (pagedir_get_page (pd, upage) == vdso)
+    pagedir_clear_page (pd, upage);
+#endif
+}
+
+/* Updates the tick count and load average in the vDSO page.
+   Called by the timer interrupt handler on every tick. */
+void
+vdso_tick (void)
+{
+  if (vdso == NULL)
+    return;
+  vdso->seq++;
+  barrier ();
+  vdso->ticks = timer_ticks ();
+  barrier ();
+  vdso->seq++;
+  vdso->load_avg = thread_get_load_avg ();
+}
+
+/* Records TID as the running process's thread id in the vDSO
+   page.  Called whenever a process is switched in. */
+void
+vdso_set_tid (int tid)
+{
+  if (vdso != NULL)
+    vdso->tid = tid;
+}
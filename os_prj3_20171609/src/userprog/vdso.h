@@ -0,0 +1,66 @@
+#ifndef USERPROG_VDSO_H
+#define USERPROG_VDSO_H
+
+/* The vDSO page.
+
+   A single read-only page, shared by every process and mapped at
+   VDSO_BASE, that answers simple queries without a system call.
+   The kernel keeps the data at its start up to date: the timer
+   tick count on every tick, and the thread id whenever a process
+   is switched in, so that the running process always reads its
+   own.  Following the data are pointers to functions, in the same
+   page, that a process may call directly.  Among them are system
+   call stubs that enter the kernel with SYSENTER when the CPU
+   supports it and with INT $0x30 otherwise. */
+
+/* User address of the vDSO page.  Just below where executables
+   are linked, and far from the stack. */
+#define VDSO_BASE 0x08000000
+
+/* Byte offsets of the fields in struct vdso_page, for vdso.S. */
+#define VDSO_SEQ 0
+#define VDSO_TICKS 4
+#define VDSO_TID 12
+#define VDSO_LOAD_AVG 16
+
+/* Offset of the code within the page. */
+#define VDSO_TEXT_OFS 256
+
+/* System call numbers used by vdso.S, which cannot include
+   <syscall-nr.h>.  vdso_init() checks that they match. */
+#define VDSO_SYS_READ 8
+#define VDSO_SYS_WRITE 9
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Layout of the start of the vDSO page. */
+struct vdso_page
+  {
+    uint32_t seq;               /* Odd while TICKS is being updated. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    int tid;                    /* Running process's thread id. */
+    int load_avg;               /* 100 times the load average. */
+
+    /* Functions callable from user mode. */
+    int64_t (*get_ticks) (void);
+    int (*get_tid) (void);
+    int (*get_load_avg) (void);
+    int (*fibonacci) (int n);
+    int (*max_of_four_int) (int a, int b, int c, int d);
+
+    /* System calls. */
+    int (*syscall) (int number, ...);
+    int (*read) (int fd, void *buffer, unsigned size);
+    int (*write) (int fd, const void *buffer, unsigned size);
+  };
+
+void vdso_init (void);
+bool vdso_map (void);
+void vdso_unmap (void);
+void vdso_tick (void);
+void vdso_set_tid (int tid);
+#endif
+
+#endif /* userprog/vdso.h */
@@ -0,0 +1,434 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Frame table.
+
+   Every frame from the user pool that holds a user page has a
+   struct frame here.  When the user pool runs dry, a frame is
+   reclaimed from some process with the "enhanced second chance"
+   clock algorithm, which prefers pages that have been neither
+   accessed nor modified recently, since those cost no write to
+   evict.
+
+   Frames holding read-only pages of a file, that is, the text of
+   an executable, are also entered in a page cache keyed by inode
+   and offset, so that every process running the executable maps
+   the same frame instead of reading its own copy.  A cached frame
+   leaves the cache when its last page is unmapped or it is
+   evicted; since its pages are never written, eviction costs
+   nothing but the later re-read. */
+
+struct lock frame_lock;
+struct condition frame_io_done;
+
+static struct list frame_list;      /* All frames, in clock order. */
+static size_t frame_cnt;            /* Number of elements in frame_list. */
+static struct list_elem *hand;      /* Next frame the clock examines. */
+static struct hash frame_cache;     /* Cached frames, by inode and offset. */
+
+/* A frame of zeros, mapped read-only for every all-zero page
+   that has only been read so far.  It is wired, so it is never
+   evicted, and it never drops its own reference, so it is never
+   freed and always looks shared to a writer. */
+static struct frame zero_frame;
+
+static struct frame *choose_victim (void);
+static bool evict (struct frame *);
+static bool frame_accessed (struct frame *, bool clear);
+static bool frame_dirty (struct frame *);
+static bool frame_locked (struct frame *);
+static struct frame *clock_next (void);
+static void cache_remove (struct frame *);
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  lock_init (&frame_lock);
+  cond_init (&frame_io_done);
+  list_init (&frame_list);
+  frame_cnt = 0;
+  hand = NULL;
+  hash_init (&frame_cache, cache_hash, cache_less, NULL);
+
+  zero_frame.kpage = palloc_get_page (PAL_ZERO);
+  if (zero_frame.kpage == NULL)
+    PANIC ("frame: zero frame allocation failed");
+  list_init (&zero_frame.pages);
+  zero_frame.ref_cnt = 1;
+  zero_frame.pinned = true;
+  zero_frame.wired = true;
+  zero_frame.inode = NULL;
+}
+
+/* Returns the shared zero frame. */
+struct frame *
+frame_zero (void)
+{
+  return &zero_frame;
+}
+
+/* Obtains a frame for PAGE on behalf of the current thread,
+   evicting another page if no frame is free.  If PAGE is null,
+   the frame starts out with no pages, and the caller adds them
+   with frame_share().  The frame is returned pinned; the caller
+   unpins it once its page is mapped.  Returns a null pointer if
+   no frame can be freed.
+   Evicting a page may release frame_lock for a while, so the
+   caller must recheck anything it found out before the call.
+   The caller must hold frame_lock. */
+struct frame *
+frame_alloc (struct page *page)
+{
+  struct frame *f = frame_try_alloc (page);
+
+  if (f != NULL)
+    return f;
+
+  f = choose_victim ();
+  if (f == NULL)
+    return NULL;
+  f->pinned = true;
+  if (!evict (f))
+    {
+      f->pinned = false;
+      return NULL;
+    }
+
+  cache_remove (f);
+  list_init (&f->pages);
+  f->ref_cnt = 0;
+  if (page != NULL)
+    frame_share (f, page);
+  return f;
+}
+
+/* Like frame_alloc(), but only takes a free frame from the user
+   pool, never evicting a page, so frame_lock is held throughout.
+   Returns a null pointer if none is free. */
+struct frame *
+frame_try_alloc (struct page *page)
+{
+  struct frame *f;
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+
+  /* Insert just behind the hand, so that the new frame is the
+     last one the clock looks at. */
+  if (hand != NULL && hand != list_end (&frame_list))
+    list_insert (hand, &f->elem);
+  else
+    list_push_back (&frame_list, &f->elem);
+  frame_cnt++;
+
+  list_init (&f->pages);
+  f->ref_cnt = 0;
+  if (page != NULL)
+    frame_share (f, page);
+  f->pinned = true;
+  f->wired = false;
+  f->inode = NULL;
+  return f;
+}
+
+/* Allocates a zeroed, wired frame from the user pool, with no
+   pages mapped to it yet and one reference held by the caller,
+   which the caller drops with frame_release().  Wired frames are
+   never evicted, so none is evicted to make room for one either.
+   Returns a null pointer if the user pool is exhausted.
+   The caller must hold frame_lock. */
+struct frame *
+frame_alloc_wired (void)
+{
+  struct frame *f;
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  list_init (&f->pages);
+  f->ref_cnt = 1;
+  f->pinned = true;
+  f->wired = true;
+  f->inode = NULL;
+  return f;
+}
+
+/* Drops the reference to wired frame F held by whoever allocated
+   it, and frees F if no page is left mapped to it.
+   The caller must hold frame_lock. */
+void
+frame_release (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f->wired && f->ref_cnt > 0);
+
+  if (--f->ref_cnt == 0)
+    frame_free (f);
+}
+
+/* Removes F from the frame table and frees its page.
+   The caller must hold frame_lock and must already have unmapped
+   F's pages. */
+void
+frame_free (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  if (!f->wired)
+    {
+      if (hand == &f->elem)
+        hand = list_next (hand);
+      list_remove (&f->elem);
+      frame_cnt--;
+    }
+  cache_remove (f);
+
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Adds PAGE to the pages mapped to F.
+   The caller must hold frame_lock. */
+void
+frame_share (struct frame *f, struct page *page)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  list_push_back (&f->pages, &page->frame_elem);
+  f->ref_cnt++;
+}
+
+/* Removes PAGE, which the caller has already unmapped, from the
+   pages mapped to F, and frees F if no page is left.
+   The caller must hold frame_lock. */
+void
+frame_unshare (struct frame *f, struct page *page)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f->ref_cnt > 0);
+
+  list_remove (&page->frame_elem);
+  if (--f->ref_cnt == 0)
+    frame_free (f);
+}
+
+/* Returns the cached frame holding the READ_BYTES bytes at
+   offset OFS in INODE, or a null pointer if there is none.
+   The caller must hold frame_lock. */
+struct frame *
+frame_cache_lookup (struct inode *inode, off_t ofs, uint32_t read_bytes)
+{
+  struct frame key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  key.inode = inode;
+  key.file_ofs = ofs;
+  key.read_bytes = read_bytes;
+  e = hash_find (&frame_cache, &key.cache_elem);
+  return e != NULL ? hash_entry (e, struct frame, cache_elem) : NULL;
+}
+
+/* Enters F, which holds the READ_BYTES bytes at offset OFS in
+   INODE and is mapped read-only, in the page cache.
+   The caller must hold frame_lock. */
+void
+frame_cache_insert (struct frame *f, struct inode *inode, off_t ofs,
+                    uint32_t read_bytes)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f->inode == NULL);
+
+  f->inode = inode;
+  f->file_ofs = ofs;
+  f->read_bytes = read_bytes;
+  if (hash_insert (&frame_cache, &f->cache_elem) != NULL)
+    f->inode = NULL;
+}
+
+/* Removes F from the page cache, if it is there. */
+static void
+cache_remove (struct frame *f)
+{
+  if (f->inode != NULL)
+    {
+      hash_delete (&frame_cache, &f->cache_elem);
+      f->inode = NULL;
+    }
+}
+
+/* Returns a hash value for cached frame E. */
+static unsigned
+cache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->file_ofs);
+}
+
+/* Returns true if cached frame A precedes cached frame B. */
+static bool
+cache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry (b_, struct frame, cache_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->file_ofs != b->file_ofs)
+    return a->file_ofs < b->file_ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+/* Evicts every page mapped to F.  Returns true if successful,
+   false if a page could not be written to swap, in which case
+   F is left as it was. */
+static bool
+evict (struct frame *f)
+{
+  struct list_elem *e;
+
+  /* choose_victim() only picks a shared frame if no page needs
+     writing out, so only an unshared frame can fail here. */
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (!page_out (list_entry (e, struct page, frame_elem)))
+      return false;
+  return true;
+}
+
+/* Returns true if any page mapped to F is locked in memory. */
+static bool
+frame_locked (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (list_entry (e, struct page, frame_elem)->locked)
+      return true;
+  return false;
+}
+
+/* Returns true if any page mapped to F has been accessed since
+   the last time its accessed bit was cleared.  If CLEAR is true,
+   clears the accessed bits. */
+static bool
+frame_accessed (struct frame *f, bool clear)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          accessed = true;
+          if (clear)
+            pagedir_set_accessed (pd, p->upage, false);
+        }
+    }
+  return accessed;
+}
+
+/* Returns true if evicting F would cost a write, that is, if any
+   page mapped to F has been modified or is a mapped file page. */
+static bool
+frame_dirty (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+
+      if (p->dirty || p->mapped || pagedir_is_dirty (p->owner->pagedir,
+                                                     p->upage))
+        return true;
+    }
+  return false;
+}
+
+/* Chooses a frame to evict, or returns a null pointer if every
+   frame is pinned, locked by mlock(), or shared and dirty.
+
+   The first lap around the clock looks for a frame whose page is
+   neither accessed nor dirty.  The second settles for one that
+   is not accessed, and clears the accessed bit of each page it
+   passes over, so that a page is only evicted if it stays unused
+   for a full lap.  Two more laps repeat the search with the
+   accessed bits cleared.
+
+   A frame shared copy-on-write is only evicted if it is clean,
+   since its pages would otherwise each need their own copy in
+   swap.  Once the sharing ends it is treated like any other. */
+static struct frame *
+choose_victim (void)
+{
+  int lap;
+  size_t i;
+
+  for (lap = 0; lap < 4; lap++)
+    for (i = 0; i < frame_cnt; i++)
+      {
+        struct frame *f = clock_next ();
+
+        if (f->pinned || frame_locked (f) || frame_accessed (f, lap % 2 == 1))
+          continue;
+        if ((lap % 2 == 0 || f->ref_cnt > 1) && frame_dirty (f))
+          continue;
+        return f;
+      }
+  return NULL;
+}
+
+/* Returns the frame under the clock hand and advances the hand,
+   wrapping around at the end of the list. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  ASSERT (!list_empty (&frame_list));
+
+  if (hand == NULL || hand == list_end (&frame_list))
+    hand = list_begin (&frame_list);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
@@ -0,0 +1,65 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct inode;
+struct page;
+struct thread;
+
+/* A physical frame holding a user page.
+
+   Usually one process maps the frame, but after fork() parent and
+   child share it copy-on-write until one of them writes to it,
+   and every process running an executable shares the frames of
+   its read-only pages, so a frame keeps a list of every page
+   mapped to it.
+
+   A WIRED frame is not in the clock list, so it is never evicted.
+   Whoever allocated it holds a reference of its own, on top of
+   those of its pages, and the frame is freed once that reference
+   and every page are gone. */
+struct frame
+  {
+    struct list_elem elem;      /* Element in the clock list. */
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped to this frame. */
+    size_t ref_cnt;             /* Elements in PAGES, plus 1 if WIRED. */
+    bool pinned;                /* True: may not be evicted. */
+    bool wired;                 /* True: not in the clock list. */
+
+    /* Read-only file page cached for sharing, if INODE is
+       nonnull: READ_BYTES bytes at FILE_OFS in INODE. */
+    struct hash_elem cache_elem; /* Element in the page cache. */
+    struct inode *inode;        /* File, or null if not cached. */
+    off_t file_ofs;             /* Offset in file. */
+    uint32_t read_bytes;        /* Bytes read from file. */
+  };
+
+/* Serializes paging: the frame table, and moving pages into and
+   out of frames.  It is not held during disk I/O: a page being
+   written out is marked busy instead, and FRAME_IO_DONE is
+   broadcast, with frame_lock held, once it is no longer busy. */
+extern struct lock frame_lock;
+extern struct condition frame_io_done;
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+void frame_free (struct frame *);
+struct frame *frame_alloc_wired (void);
+void frame_release (struct frame *);
+struct frame *frame_zero (void);
+void frame_share (struct frame *, struct page *);
+void frame_unshare (struct frame *, struct page *);
+struct frame *frame_cache_lookup (struct inode *, off_t ofs,
+                                  uint32_t read_bytes);
+void frame_cache_insert (struct frame *, struct inode *, off_t ofs,
+                         uint32_t read_bytes);
+
+#endif /* vm/frame.h */
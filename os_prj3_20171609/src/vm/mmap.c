@@ -0,0 +1,163 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping covers consecutive pages starting at a page-aligned
+   user address, one per page of the file, the last one padded
+   with zeros.  Its pages live in the supplemental page table like
+   any others and are read in by page_in() when first touched; the
+   only difference is that a mapped page is written back to the
+   file, and only if modified, instead of going to swap.  So a
+   process can scan a file through a mapping without copying it
+   through a read() buffer or holding the file system lock for
+   longer than each page read. */
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in thread's `mappings'. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Private handle on the file. */
+    void *base;                 /* First mapped user page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+static struct mapping *lookup (mapid_t);
+static void unmap (struct mapping *);
+static void remove_pages (void *base, size_t page_cnt);
+
+/* Maps FILE into the current process's address space starting at
+   ADDR.  The mapping uses its own handle on FILE, so it survives
+   closing the descriptor FILE came from.  Returns the new
+   mapping's identifier, or MAP_FAILED if ADDR is null or not page
+   aligned, FILE is empty, any page of the mapping would overlap
+   an existing page or the stack, or memory is exhausted. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr))
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+
+  lock_acquire (&lockflag);
+  m->file = file_reopen (file);
+  length = m->file != NULL ? file_length (m->file) : 0;
+  lock_release (&lockflag);
+  if (length == 0)
+    goto fail;
+
+  /* Keep clear of the region the stack may grow into. */
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  if (m->page_cnt + stack_page_limit > pg_no (PHYS_BASE) - pg_no (addr))
+    goto fail;
+
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      uint32_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (pagedir_get_page (t->pagedir, upage) != NULL
+          || !page_add_mmap (upage, m->file, ofs, read_bytes))
+        {
+          remove_pages (addr, i);
+          goto fail;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+
+ fail:
+  lock_acquire (&lockflag);
+  file_close (m->file);
+  lock_release (&lockflag);
+  free (m);
+  return MAP_FAILED;
+}
+
+/* Unmaps the current process's mapping ID, writing back any pages
+   that were modified.  Returns true if successful, false if there
+   is no such mapping. */
+bool
+mmap_unmap (mapid_t id)
+{
+  struct mapping *m = lookup (id);
+
+  if (m == NULL)
+    return false;
+  unmap (m);
+  return true;
+}
+
+/* Unmaps all of the current process's mappings.  Called on exit,
+   before the supplemental page table is destroyed. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
+
+/* Returns the current process's mapping ID, or a null pointer if
+   there is none. */
+static struct mapping *
+lookup (mapid_t id)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings); e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages, writing back modified ones, and frees M. */
+static void
+unmap (struct mapping *m)
+{
+  remove_pages (m->base, m->page_cnt);
+  list_remove (&m->elem);
+
+  lock_acquire (&lockflag);
+  file_close (m->file);
+  lock_release (&lockflag);
+  free (m);
+}
+
+/* Removes the PAGE_CNT pages starting at BASE from the current
+   process's supplemental page table. */
+static void
+remove_pages (void *base, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_remove ((uint8_t *) base + i * PGSIZE);
+}
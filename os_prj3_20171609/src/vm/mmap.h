@@ -0,0 +1,13 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <stdbool.h>
+#include "userprog/syscall.h"
+
+struct file;
+
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
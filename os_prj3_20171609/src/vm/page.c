@@ -0,0 +1,1025 @@
+#include "vm/page.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Maximum size of a process's stack, in pages.  The stack grows
+   on demand up to this many pages below PHYS_BASE. */
+size_t stack_page_limit = 2048;
+
+/* Maximum number of pages that may be locked by mlock() at once,
+   in all processes together, so that locked pages cannot take
+   every user frame away from paging. */
+size_t lock_page_limit = 64;
+
+/* Number of pages currently locked.  Protected by frame_lock. */
+static size_t locked_page_cnt;
+
+/* Maximum number of pages mapped ahead of a faulting page by
+   fault_around(), normally and under MADV_SEQUENTIAL. */
+#define FAULT_AROUND_PAGES 8
+#define READ_AHEAD_PAGES 32
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+static struct page *page_create (void *upage, struct file *, off_t ofs,
+                                 uint32_t read_bytes, bool writable);
+static bool page_add (struct page *);
+static void page_write_back (struct page *, struct thread *, bool unlock);
+static void page_wait (struct page *);
+static bool page_table_busy (struct thread *);
+static bool page_load (struct page *, bool write, bool evict);
+static bool page_unshare (struct page *);
+static bool page_is_shareable (const struct page *);
+static bool page_map_resident (struct page *, bool write);
+static void fault_around (struct page *, bool write);
+static bool range_exists (const void *addr, size_t length);
+static void page_drop (struct page *);
+static void swap_read_around (struct page *);
+static struct page *lookup (struct thread *, const void *upage);
+
+/* Initializes the current process's supplemental page table.
+   Returns true if successful, false if memory is exhausted. */
+bool
+page_table_init (void)
+{
+  struct thread *t = thread_current ();
+  return hash_init (&t->pages, page_hash, page_less, t);
+}
+
+/* Frees every page in the current process's supplemental page
+   table, along with the frames and swap slots holding them.
+   Must be called before the process's page directory is
+   destroyed. */
+void
+page_table_destroy (void)
+{
+  struct thread *t = thread_current ();
+
+  lock_acquire (&frame_lock);
+  while (page_table_busy (t))
+    cond_wait (&frame_io_done, &frame_lock);
+  hash_destroy (&t->pages, page_destroy);
+  lock_release (&frame_lock);
+}
+
+/* Returns true if any of T's pages is busy.
+   The caller must hold frame_lock. */
+static bool
+page_table_busy (struct thread *t)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    if (hash_entry (hash_cur (&i), struct page, hash_elem)->busy)
+      return true;
+  return false;
+}
+
+/* Adds a page at user virtual address UPAGE whose contents are
+   the READ_BYTES bytes at offset OFS in FILE followed by zeros.
+   The page is not read until it is first touched.
+   Returns true if successful, false if UPAGE is already in use or
+   memory is exhausted. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes, bool writable)
+{
+  struct page *p = page_create (upage, file, ofs, read_bytes, writable);
+  bool success;
+
+  if (p == NULL)
+    return false;
+  lock_acquire (&frame_lock);
+  success = page_add (p);
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Adds an all-zero page at user virtual address UPAGE.
+   Returns true if successful, false if UPAGE is already in use or
+   memory is exhausted. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add_file (upage, NULL, 0, 0, writable);
+}
+
+/* Adds a writable page at user virtual address UPAGE that maps
+   the READ_BYTES bytes at offset OFS in FILE, followed by zeros.
+   The page is read when it is first touched, and written back to
+   FILE if modified.
+   Returns true if successful, false if UPAGE is already in use or
+   memory is exhausted. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               uint32_t read_bytes)
+{
+  struct page *p = page_create (upage, file, ofs, read_bytes, true);
+  bool success;
+
+  if (p == NULL)
+    return false;
+  p->mapped = true;
+  lock_acquire (&frame_lock);
+  success = page_add (p);
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Adds a page at user virtual address UPAGE and maps it to wired
+   frame F at once.  Returns true if successful, false if UPAGE is
+   already in use, either in the supplemental page table or in the
+   page directory, or memory is exhausted. */
+bool
+page_add_wired (void *upage, struct frame *f, bool writable)
+{
+  struct page *p;
+
+  ASSERT (f->wired);
+
+  if (pagedir_get_page (thread_current ()->pagedir, upage) != NULL)
+    return false;
+  p = page_create (upage, NULL, 0, 0, writable);
+  if (p == NULL)
+    return false;
+  p->wired = true;
+
+  lock_acquire (&frame_lock);
+  if (!page_add (p))
+    {
+      lock_release (&frame_lock);
+      return false;
+    }
+  if (!pagedir_set_page (p->owner->pagedir, upage, f->kpage, writable))
+    {
+      hash_delete (&p->owner->pages, &p->hash_elem);
+      free (p);
+      lock_release (&frame_lock);
+      return false;
+    }
+  frame_share (f, p);
+  p->frame = f;
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Removes the current process's page at UPAGE, which must exist,
+   writing it back to its file first if it is a modified mapped
+   page. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (upage);
+
+  ASSERT (p != NULL);
+
+  lock_acquire (&frame_lock);
+  page_wait (p);
+  hash_delete (&t->pages, &p->hash_elem);
+  page_destroy (&p->hash_elem, t);
+  lock_release (&frame_lock);
+}
+
+/* Returns the current process's page at user virtual address
+   UPAGE, or a null pointer if there is none. */
+struct page *
+page_lookup (const void *upage)
+{
+  return lookup (thread_current (), upage);
+}
+
+/* Returns T's page at user virtual address UPAGE, or a null
+   pointer if there is none.  T's table only changes with
+   frame_lock held, so if T is not the current thread, the caller
+   must hold frame_lock. */
+static struct page *
+lookup (struct thread *t, const void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  if (!is_user_vaddr (upage))
+    return NULL;
+  p.upage = (void *) upage;
+  e = hash_find (&t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Brings in the page containing FAULT_ADDR, if the current
+   process has one there that is not already in memory.  WRITE
+   says whether the faulting access was a write.
+   Returns true if successful, false if the fault cannot be
+   resolved this way. */
+bool
+page_in (const void *fault_addr, bool write)
+{
+  struct page *p;
+  bool success;
+
+  if (thread_current ()->pagedir == NULL || !is_user_vaddr (fault_addr))
+    return false;
+
+  p = page_lookup (pg_round_down (fault_addr));
+  if (p == NULL)
+    return false;
+
+  /* If the page was being evicted when we faulted, wait for the
+     eviction to finish. */
+  lock_acquire (&frame_lock);
+  page_wait (p);
+  if (p->frame != NULL)
+    success = true;
+  else
+    {
+      success = page_load (p, write, true);
+      if (success)
+        fault_around (p, write);
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Copies PARENT's supplemental page table into the current
+   process's, for fork().  PARENT must be blocked for the
+   duration.  Resident pages are shared copy-on-write: the frame
+   is mapped read-only into both processes, and whichever writes
+   first gets a private copy in page_write_fault().  Swapped-out
+   pages are copied to a new swap slot, and pages not yet loaded
+   just copy their description.  Memory-mapped files and wired
+   pages are not inherited.
+   Returns true if successful, false if memory or swap is
+   exhausted. */
+bool
+page_table_copy (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+  uint8_t *buffer;
+  bool success = true;
+
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return false;
+
+  lock_acquire (&frame_lock);
+  hash_first (&i, &parent->pages);
+  while (success && hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct file *file = p->file;
+      struct page *q;
+
+      if (p->mapped || p->wired)
+        continue;
+      page_wait (p);
+
+      /* Executable pages read from the child's own handle on the
+         executable, which outlives the parent's. */
+      if (file != NULL && file == parent->exec_file)
+        file = t->exec_file;
+      q = page_create (p->upage, file, p->file_ofs, p->read_bytes,
+                       p->writable);
+      if (q == NULL || !page_add (q))
+        {
+          success = false;
+          break;
+        }
+
+      if (p->frame != NULL)
+        {
+          if (pagedir_is_dirty (parent->pagedir, p->upage))
+            p->dirty = true;
+          if (p->writable)
+            pagedir_set_writable (parent->pagedir, p->upage, false);
+          if (!pagedir_set_page (t->pagedir, q->upage, p->frame->kpage,
+                                 false))
+            success = false;
+          else
+            {
+              frame_share (p->frame, q);
+              q->frame = p->frame;
+            }
+        }
+      else if (p->swap_slot != SWAP_NONE)
+        {
+          q->swap_slot = swap_alloc (1);
+          if (q->swap_slot != SWAP_NONE)
+            {
+              swap_read (p->swap_slot, buffer);
+              swap_write (q->swap_slot, buffer);
+            }
+          else
+            success = false;
+        }
+      q->dirty = p->dirty;
+      q->advice = p->advice;
+    }
+  lock_release (&frame_lock);
+
+  palloc_free_page (buffer);
+  return success;
+}
+
+/* Handles a write to the present, read-only page containing
+   FAULT_ADDR, if it is a writable page of the current process
+   whose frame is shared copy-on-write: gives the page a private
+   copy of the frame, or, if no other page shares the frame any
+   longer, simply makes the page writable.
+   Returns true if successful, false if the write is a genuine
+   protection violation or memory is exhausted. */
+bool
+page_write_fault (const void *fault_addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+  bool success = true;
+
+  if (pd == NULL || !is_user_vaddr (fault_addr))
+    return false;
+
+  p = page_lookup (pg_round_down (fault_addr));
+  if (p == NULL || !p->writable)
+    return false;
+
+  lock_acquire (&frame_lock);
+  page_wait (p);
+  if (p->frame == NULL)
+    {
+      /* Evicted since the fault: reloading gives a private,
+         writable frame. */
+      success = page_load (p, true, true);
+    }
+  else if (p->frame->ref_cnt == 1)
+    pagedir_set_writable (pd, p->upage, true);
+  else
+    success = page_unshare (p);
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Gives writable page P, which is in memory in a frame shared
+   with other pages or in the zero frame, a private, writable
+   frame holding the same data.  Returns true if successful,
+   false if memory is exhausted, in which case P still holds its
+   data, though it may no longer be in memory.  The caller must
+   hold frame_lock. */
+static bool
+page_unshare (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  struct frame *old = p->frame;
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (p->writable && !p->wired && old != NULL && !p->busy);
+
+  if (old == frame_zero ())
+    {
+      /* Nothing to copy: take a fresh frame and zero it. */
+      pagedir_clear_page (pd, p->upage);
+      frame_unshare (old, p);
+      p->frame = NULL;
+      return page_load (p, true, true);
+    }
+
+  /* Take the new frame before letting go of OLD.  Evicting a
+     frame may drop frame_lock, but P keeps OLD from being freed
+     meanwhile; at worst OLD itself is evicted, taking P along. */
+  f = frame_alloc (NULL);
+  if (f == NULL)
+    return false;
+  if (p->frame != old)
+    {
+      frame_free (f);
+      return page_load (p, true, true);
+    }
+  memcpy (f->kpage, old->kpage, PGSIZE);
+  pagedir_clear_page (pd, p->upage);
+  frame_unshare (old, p);
+  frame_share (f, p);
+  pagedir_set_page (pd, p->upage, f->kpage, true);
+  p->frame = f;
+  f->pinned = false;
+  return true;
+}
+
+/* Grows the current process's stack to cover FAULT_ADDR, if that
+   looks like a stack access given user stack pointer ESP, by
+   adding a new zero page there and bringing it in.  PUSH faults
+   4 bytes below ESP and PUSHA 32 bytes below it, before ESP is
+   decremented; anything further below ESP is a bad access.
+   Returns true if successful, false if FAULT_ADDR is not a stack
+   access, lies beyond stack_page_limit, or memory is exhausted. */
+bool
+page_grow_stack (const void *fault_addr, const void *esp)
+{
+  void *upage = pg_round_down (fault_addr);
+
+  if (thread_current ()->pagedir == NULL || !is_user_vaddr (fault_addr)
+      || (uint8_t *) fault_addr < (uint8_t *) esp - 32
+      || pg_no (PHYS_BASE) - pg_no (upage) > stack_page_limit)
+    return false;
+
+  return page_add_zero (upage, true) && page_in (upage, true);
+}
+
+/* Evicts page P from its frame.  Unmaps
+   P and, if its contents can no longer be read back from its
+   file, writes them to swap, or back to the file if P is a
+   modified mapped page.  The frame itself is left for the
+   caller to reuse.  Returns true if successful, false if swap is
+   full, in which case P stays in its frame.
+
+   When P must go to swap, up to SWAP_CLUSTER - 1 of the pages
+   that follow it in OWNER's address space go with it, if they
+   are resident, idle, and also need swapping.  The cluster is
+   written to adjacent slots in a single pass and the extra frames
+   are freed, so the next few evictions cost no disk I/O and a
+   later fault can read the whole cluster back at once.  The
+   block layer still takes one request per sector, so clustering
+   keeps swap I/O sequential but does not cut the number of
+   requests.
+
+   The caller must hold frame_lock and have pinned P's frame.
+   frame_lock is released while pages are written out, with the
+   pages marked busy, so the caller must recheck anything it found
+   out before the call. */
+bool
+page_out (struct page *p)
+{
+  struct thread *owner = p->owner;
+  uint32_t *pd = owner->pagedir;
+  struct page *cluster[SWAP_CLUSTER];
+  size_t cnt, slot, i;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (p->frame != NULL);
+
+  /* Unmap first, so that OWNER faults (and waits for us) rather
+     than modifying the page while it is written out. */
+  pagedir_clear_page (pd, p->upage);
+  if (p->mapped)
+    {
+      page_write_back (p, owner, true);
+      p->frame = NULL;
+      return true;
+    }
+  if (pagedir_is_dirty (pd, p->upage))
+    p->dirty = true;
+  if (!p->dirty)
+    {
+      p->frame = NULL;
+      return true;
+    }
+
+  /* Gather the cluster. */
+  cluster[0] = p;
+  for (cnt = 1; cnt < SWAP_CLUSTER; cnt++)
+    {
+      struct page *q = lookup (owner, (uint8_t *) p->upage + cnt * PGSIZE);
+
+      if (q == NULL || q->mapped || q->locked || q->busy || q->frame == NULL
+          || q->frame->pinned || q->frame->ref_cnt > 1
+          || pagedir_is_accessed (pd, q->upage)
+          || !(q->dirty || pagedir_is_dirty (pd, q->upage)))
+        break;
+      cluster[cnt] = q;
+    }
+
+  /* Find adjacent slots for as much of it as possible. */
+  while ((slot = swap_alloc (cnt)) == SWAP_NONE && cnt > 1)
+    cnt--;
+  if (slot == SWAP_NONE)
+    {
+      pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+      return false;
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *q = cluster[i];
+
+      if (i > 0)
+        {
+          q->frame->pinned = true;
+          pagedir_clear_page (pd, q->upage);
+          q->dirty = true;
+        }
+      q->swap_slot = slot + i;
+      q->busy = true;
+    }
+
+  lock_release (&frame_lock);
+  for (i = 0; i < cnt; i++)
+    swap_write (slot + i, cluster[i]->frame->kpage);
+  lock_acquire (&frame_lock);
+
+  for (i = 0; i < cnt; i++)
+    {
+      if (i > 0)
+        frame_free (cluster[i]->frame);
+      cluster[i]->frame = NULL;
+      cluster[i]->busy = false;
+    }
+  cond_broadcast (&frame_io_done, &frame_lock);
+  return true;
+}
+
+/* Applies madvise() ADVICE to the pages of the current process
+   covering the LENGTH bytes starting at ADDR.  MADV_NORMAL,
+   MADV_RANDOM and MADV_SEQUENTIAL are remembered per page and
+   steer fault_around().  MADV_WILLNEED brings the pages in now.
+   MADV_DONTNEED drops the resident pages that can be read back
+   unchanged, leaving modified ones alone.
+   Returns true if successful, false if ADDR is not page aligned,
+   ADVICE is unknown, or part of the range is not mapped. */
+bool
+page_advise (void *addr, size_t length, int advice)
+{
+  uint8_t *upage;
+
+  if (pg_ofs (addr) != 0 || advice < MADV_NORMAL || advice > MADV_DONTNEED
+      || !range_exists (addr, length))
+    return false;
+
+  lock_acquire (&frame_lock);
+  for (upage = addr; upage < (uint8_t *) addr + length; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (upage);
+
+      page_wait (p);
+      if (advice == MADV_WILLNEED)
+        {
+          /* Only a hint, so a failure is not an error. */
+          if (p->frame == NULL)
+            page_load (p, false, true);
+        }
+      else if (advice == MADV_DONTNEED)
+        page_drop (p);
+      else
+        p->advice = advice;
+    }
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Locks in memory, if LOCK is true, or unlocks the pages of the
+   current process covering the LENGTH bytes starting at ADDR.
+   Locking brings each page in, with a frame of its own if it is
+   writable, breaking any copy-on-write or zero-frame sharing at
+   once, and keeps the clock from evicting it until it is
+   unlocked.  No more than lock_page_limit pages may be locked at
+   once, across all processes.  Returns true if successful, false
+   if part of the range is not mapped, the limit would be
+   exceeded, or memory is exhausted; on failure, the pages that
+   were already locked stay locked, and no others are. */
+bool
+page_lock_range (const void *addr, size_t length, bool lock)
+{
+  uint8_t *start = pg_round_down (addr);
+  struct bitmap *newly_locked = NULL;
+  size_t page_cnt, i;
+  bool success = true;
+
+  length += pg_ofs (addr);
+  if (!range_exists (start, length))
+    return false;
+  page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  if (lock)
+    {
+      newly_locked = bitmap_create (page_cnt);
+      if (newly_locked == NULL)
+        return false;
+    }
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < page_cnt; i++)
+    {
+      struct page *p = page_lookup (start + i * PGSIZE);
+
+      page_wait (p);
+      if (!lock)
+        {
+          if (p->locked)
+            {
+              p->locked = false;
+              locked_page_cnt--;
+            }
+          continue;
+        }
+
+      if (!p->locked)
+        {
+          if (locked_page_cnt >= lock_page_limit)
+            {
+              success = false;
+              break;
+            }
+          p->locked = true;
+          locked_page_cnt++;
+          bitmap_mark (newly_locked, i);
+        }
+      if (p->frame == NULL)
+        success = page_load (p, p->writable, true);
+      else if (p->writable && !p->wired
+               && (p->frame == frame_zero () || p->frame->ref_cnt > 1))
+        success = page_unshare (p);
+      if (!success)
+        break;
+    }
+  if (!success)
+    for (i = 0; i < page_cnt; i++)
+      if (bitmap_test (newly_locked, i))
+        {
+          page_lookup (start + i * PGSIZE)->locked = false;
+          locked_page_cnt--;
+        }
+  lock_release (&frame_lock);
+
+  bitmap_destroy (newly_locked);
+  return success;
+}
+
+/* Returns true if the current process has a page for every
+   byte of the LENGTH bytes starting at page-aligned ADDR. */
+static bool
+range_exists (const void *addr, size_t length)
+{
+  const uint8_t *upage;
+
+  if (!is_user_vaddr (addr)
+      || length > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) addr))
+    return false;
+  for (upage = addr; upage < (const uint8_t *) addr + length;
+       upage += PGSIZE)
+    if (page_lookup (upage) == NULL)
+      return false;
+  return true;
+}
+
+/* Drops resident page P from its frame if it can be read back
+   unchanged from its file, or is all zeros, and is not locked or
+   wired.  The caller must hold frame_lock. */
+static void
+page_drop (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  if (p->frame == NULL || p->locked || p->wired || p->dirty
+      || pagedir_is_dirty (pd, p->upage))
+    return;
+
+  pagedir_clear_page (pd, p->upage);
+  frame_unshare (p->frame, p);
+  p->frame = NULL;
+}
+
+/* Returns a new page at UPAGE with the given contents, not yet
+   in any page table, or a null pointer if memory is exhausted. */
+static struct page *
+page_create (void *upage, struct file *file, off_t ofs,
+             uint32_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->owner = thread_current ();
+  p->upage = upage;
+  p->writable = writable;
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->dirty = false;
+  p->mapped = false;
+  p->wired = false;
+  p->advice = MADV_NORMAL;
+  p->locked = false;
+  p->busy = false;
+  p->file = read_bytes > 0 ? file : NULL;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return p;
+}
+
+/* Inserts P into the current process's supplemental page table.
+   Frees P and returns false if its address is already in use.
+   The caller must hold frame_lock, since page_out() looks up
+   pages in other processes' tables, and an insertion may rehash
+   the table under it. */
+static bool
+page_add (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (pg_ofs (p->upage) == 0);
+  ASSERT (is_user_vaddr (p->upage));
+
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return false;
+    }
+  return true;
+}
+
+/* Returns true if P's contents can be shared with every other
+   page that holds the same part of the same file, because P is a
+   read-only page read straight from its file. */
+static bool
+page_is_shareable (const struct page *p)
+{
+  return !p->writable && p->file != NULL && p->swap_slot == SWAP_NONE;
+}
+
+/* Maps P read-only to a frame that already holds its contents,
+   if there is one: a read-only file page to the frame caching
+   that part of the file, or an all-zero page, if WRITE is false,
+   to the shared zero frame.  Such a page only gets a frame of
+   its own on its first write, if there ever is one.  Returns true
+   if P was mapped, false if it needs a frame of its own.
+   The caller must hold frame_lock. */
+static bool
+page_map_resident (struct page *p, bool write)
+{
+  struct frame *f = NULL;
+
+  if (p->swap_slot != SWAP_NONE)
+    return false;
+  if (p->file == NULL)
+    {
+      if (!write)
+        f = frame_zero ();
+    }
+  else if (page_is_shareable (p))
+    f = frame_cache_lookup (file_get_inode (p->file), p->file_ofs,
+                            p->read_bytes);
+
+  if (f == NULL
+      || !pagedir_set_page (p->owner->pagedir, p->upage, f->kpage, false))
+    return false;
+  frame_share (f, p);
+  p->frame = f;
+  return true;
+}
+
+/* Maps up to FAULT_AROUND_PAGES pages following P, which was just
+   brought in by a fault, if page_map_resident() can map them
+   without I/O or a new frame.  Stops at the first page that is
+   missing, needs a frame of its own, or belongs to a different
+   segment than P, so that it only runs ahead through the text and
+   untouched BSS a sequential access would fault on next.
+
+   Under MADV_SEQUENTIAL, instead reads ahead up to
+   READ_AHEAD_PAGES pages into free frames, and marks the pages
+   behind P as not accessed, so that the clock evicts them first.
+   Under MADV_RANDOM, does nothing.
+   The caller must hold frame_lock. */
+static void
+fault_around (struct page *p, bool write)
+{
+  bool sequential = p->advice == MADV_SEQUENTIAL;
+  size_t cnt = sequential ? READ_AHEAD_PAGES : FAULT_AROUND_PAGES;
+  size_t i;
+
+  if (p->advice == MADV_RANDOM)
+    return;
+
+  for (i = 1; i <= cnt; i++)
+    {
+      struct page *q = lookup (p->owner, (uint8_t *) p->upage + i * PGSIZE);
+
+      if (q == NULL || q->writable != p->writable || q->mapped != p->mapped
+          || (q->file != NULL && q->file != p->file))
+        break;
+      if (q->frame == NULL && !page_map_resident (q, write)
+          && !(sequential && page_load (q, write, false)))
+        break;
+    }
+
+  if (sequential)
+    for (i = 1; i <= cnt; i++)
+      {
+        struct page *q = lookup (p->owner,
+                                 (uint8_t *) p->upage - i * PGSIZE);
+
+        if (q == NULL)
+          break;
+        if (q->frame != NULL && !q->locked)
+          pagedir_set_accessed (p->owner->pagedir, q->upage, false);
+      }
+}
+
+/* Allocates a frame for P, fills it in from swap or from P's
+   file, and maps it into the current process's address space,
+   unless page_map_resident() can map it without either.  If
+   EVICT is false, only a free frame is used.
+   Returns true if successful, false otherwise.
+   The caller must hold frame_lock, which is released while the
+   frame is read.  That is safe because the frame stays pinned,
+   P is not mapped to it until it is filled in, and only P's
+   owner, the current process, changes P. */
+static bool
+page_load (struct page *p, bool write, bool evict)
+{
+  struct frame *f;
+  uint8_t *kpage;
+
+  if (page_map_resident (p, write))
+    return true;
+
+  f = evict ? frame_alloc (p) : frame_try_alloc (p);
+  if (f == NULL)
+    return false;
+  kpage = f->kpage;
+
+  if (p->swap_slot != SWAP_NONE)
+    {
+      lock_release (&frame_lock);
+      swap_read (p->swap_slot, kpage);
+      lock_acquire (&frame_lock);
+    }
+  else
+    {
+      if (p->read_bytes > 0)
+        {
+          off_t bytes_read;
+
+          lock_release (&frame_lock);
+          lock_acquire (&lockflag);
+          bytes_read = file_read_at (p->file, kpage, p->read_bytes,
+                                     p->file_ofs);
+          lock_release (&lockflag);
+          lock_acquire (&frame_lock);
+          if (bytes_read != (off_t) p->read_bytes)
+            {
+              frame_free (f);
+              return false;
+            }
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+  if (!pagedir_set_page (thread_current ()->pagedir, p->upage, kpage,
+                         p->writable))
+    {
+      frame_free (f);
+      return false;
+    }
+  p->frame = f;
+  f->pinned = false;
+
+  if (page_is_shareable (p))
+    frame_cache_insert (f, file_get_inode (p->file), p->file_ofs,
+                        p->read_bytes);
+  if (p->swap_slot != SWAP_NONE)
+    {
+      if (p->advice != MADV_RANDOM)
+        swap_read_around (p);
+      swap_free (p->swap_slot);
+      p->swap_slot = SWAP_NONE;
+    }
+  return true;
+}
+
+/* Having just read P back from swap, also reads back the pages
+   around it that were swapped out in the same cluster, that is,
+   whose slots are adjacent to P's in the same order as their
+   addresses.  Only free frames are used; nothing is evicted to
+   make room for pages that may never be touched.
+   The caller must hold frame_lock, which is released during each
+   read, as in page_load(). */
+static void
+swap_read_around (struct page *p)
+{
+  struct thread *t = thread_current ();
+  int dir;
+
+  for (dir = -1; dir <= 1; dir += 2)
+    {
+      int i;
+
+      for (i = 1; i < SWAP_CLUSTER; i++)
+        {
+          struct page *q = lookup (t, (uint8_t *) p->upage + dir * i * PGSIZE);
+          struct frame *f;
+
+          if (q == NULL || q->frame != NULL || q->swap_slot == SWAP_NONE
+              || q->swap_slot != p->swap_slot + dir * i)
+            break;
+
+          f = frame_try_alloc (q);
+          if (f == NULL)
+            return;
+          lock_release (&frame_lock);
+          swap_read (q->swap_slot, f->kpage);
+          lock_acquire (&frame_lock);
+          if (!pagedir_set_page (t->pagedir, q->upage, f->kpage, q->writable))
+            {
+              frame_free (f);
+              return;
+            }
+          swap_free (q->swap_slot);
+          q->swap_slot = SWAP_NONE;
+          q->frame = f;
+          f->pinned = false;
+        }
+    }
+}
+
+/* Unmaps and frees page E, belonging to thread AUX. */
+static void
+page_destroy (struct hash_elem *e, void *aux)
+{
+  struct thread *t = aux;
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  if (p->frame != NULL)
+    {
+      if (p->mapped)
+        page_write_back (p, t, false);
+      pagedir_clear_page (t->pagedir, p->upage);
+      frame_unshare (p->frame, p);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  if (p->locked)
+    locked_page_cnt--;
+  free (p);
+}
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_int ((int) pg_no (p->upage));
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Writes mapped page P, which belongs to T and is in a frame,
+   back to its file if T has modified it.  Clean pages are not
+   written at all.  The caller must hold frame_lock.  If UNLOCK
+   is true, frame_lock is released during the write, with P
+   marked busy; the caller must have unmapped P and pinned its
+   frame. */
+static void
+page_write_back (struct page *p, struct thread *t, bool unlock)
+{
+  ASSERT (p->mapped && p->frame != NULL);
+
+  if (p->read_bytes == 0 || !pagedir_is_dirty (t->pagedir, p->upage))
+    return;
+  pagedir_set_dirty (t->pagedir, p->upage, false);
+
+  if (unlock)
+    {
+      p->busy = true;
+      lock_release (&frame_lock);
+    }
+  lock_acquire (&lockflag);
+  file_write_at (p->file, p->frame->kpage, p->read_bytes, p->file_ofs);
+  lock_release (&lockflag);
+  if (unlock)
+    {
+      lock_acquire (&frame_lock);
+      p->busy = false;
+      cond_broadcast (&frame_io_done, &frame_lock);
+    }
+}
+
+/* Waits until P is not busy.  The caller must hold frame_lock,
+   which is released while waiting. */
+static void
+page_wait (struct page *p)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  while (p->busy)
+    cond_wait (&frame_io_done, &frame_lock);
+}
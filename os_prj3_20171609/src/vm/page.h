@@ -0,0 +1,84 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+struct thread;
+
+/* Maximum size of a process's stack, in pages. */
+extern size_t stack_page_limit;
+
+/* Maximum number of pages locked by mlock(), in all. */
+extern size_t lock_page_limit;
+
+/* A page of a process's user virtual address space.
+
+   Every user page of a process has one of these in the process's
+   supplemental page table, whether or not it is currently in
+   memory.  It records where the page's contents come from so
+   that the page can be brought in when it is first touched.
+
+   A writable page whose frame is shared with another process
+   after fork() is mapped read-only, and gets a private copy of
+   the frame on its first write.
+
+   Pages of a memory-mapped file are MAPPED: instead of going to
+   swap, their contents are written back to FILE when they are
+   evicted or unmapped, and only if the page was modified.
+
+   WIRED pages, such as those of a shared memory segment, stay
+   mapped to a wired frame for as long as they exist.
+
+   A BUSY page is being written out by page_out() without
+   frame_lock.  Its frame is pinned, and nothing but page_out()
+   may touch the page until it is no longer busy. */
+struct page
+  {
+    struct hash_elem hash_elem; /* Element in thread's `pages'. */
+    struct thread *owner;       /* Process the page belongs to. */
+    void *upage;                /* User virtual address. */
+    bool writable;              /* False: read-only page. */
+    struct frame *frame;        /* Frame holding the page, or null. */
+    struct list_elem frame_elem; /* Element in frame's `pages'. */
+    size_t swap_slot;           /* Swap slot holding the page, or SWAP_NONE. */
+    bool dirty;                 /* Modified since read from FILE? */
+    bool mapped;                /* Part of an mmap: written back to FILE. */
+    bool wired;                 /* Always mapped to a wired frame. */
+    uint8_t advice;             /* MADV_NORMAL, MADV_RANDOM, ... */
+    bool locked;                /* True: locked in memory by mlock(). */
+    bool busy;                  /* True: being written out. */
+
+    /* Initial contents: READ_BYTES bytes read from FILE starting
+       at FILE_OFS, followed by zeros to the end of the page. */
+    struct file *file;          /* File, or null if READ_BYTES == 0. */
+    off_t file_ofs;             /* Offset in FILE. */
+    uint32_t read_bytes;        /* Bytes to read from FILE. */
+  };
+
+bool page_table_init (void);
+void page_table_destroy (void);
+
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes, bool writable);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    uint32_t read_bytes);
+bool page_add_wired (void *upage, struct frame *, bool writable);
+void page_remove (void *upage);
+struct page *page_lookup (const void *upage);
+bool page_in (const void *fault_addr, bool write);
+bool page_grow_stack (const void *fault_addr, const void *esp);
+bool page_write_fault (const void *fault_addr);
+bool page_out (struct page *);
+bool page_table_copy (struct thread *parent);
+bool page_advise (void *addr, size_t length, int advice);
+bool page_lock_range (const void *addr, size_t length, bool lock);
+
+#endif /* vm/page.h */
@@ -0,0 +1,270 @@
+#include "vm/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Shared memory segments.
+
+   A segment is a run of wired frames, named by a key chosen by
+   the processes that share it.  Attaching a segment maps every
+   one of its frames, writable, into the attaching process's page
+   directory and supplemental page table, so that all processes
+   attached to it read and write the same memory with no copying
+   and no system call per access.
+
+   Each page mapped to a frame holds a reference to it, and the
+   segment holds one more.  A segment exists from shm_new()
+   until it is no longer attached anywhere, at which point it
+   drops its references and its key may be reused. */
+
+/* A shared memory segment. */
+struct segment
+  {
+    struct list_elem elem;      /* Element in `segments'. */
+    int key;                    /* Key chosen by the creator. */
+    size_t page_cnt;            /* Number of pages. */
+    struct frame **frames;      /* PAGE_CNT wired frames. */
+    int attach_cnt;             /* Number of attachments. */
+  };
+
+/* A segment attached to a process. */
+struct attachment
+  {
+    struct list_elem elem;      /* Element in thread's `shm'. */
+    struct segment *seg;        /* Segment. */
+    void *base;                 /* First user page. */
+  };
+
+/* All segments, protected by shm_lock.
+   Lock order: shm_lock before frame_lock. */
+static struct list segments;
+static struct lock shm_lock;
+
+static struct segment *lookup (int key);
+static bool valid_range (void *addr, size_t page_cnt);
+static bool attach (struct segment *, void *addr);
+static void detach (struct attachment *);
+static void segment_free (struct segment *);
+
+/* Initializes the segment table. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+}
+
+/* Creates a zero-filled segment of SIZE bytes, rounded up to a
+   whole number of pages, named KEY, and attaches it to the
+   current process at page-aligned user address ADDR.
+   Returns true if successful, false if KEY is already in use,
+   SIZE is 0, ADDR is unsuitable, or memory is exhausted. */
+bool
+shm_new (int key, size_t size, void *addr)
+{
+  struct segment *seg;
+  size_t i;
+
+  if (size == 0 || size > (uintptr_t) PHYS_BASE
+      || !valid_range (addr, DIV_ROUND_UP (size, PGSIZE)))
+    return false;
+
+  lock_acquire (&shm_lock);
+  if (lookup (key) != NULL)
+    goto fail;
+
+  seg = malloc (sizeof *seg);
+  if (seg == NULL)
+    goto fail;
+  seg->key = key;
+  seg->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  seg->attach_cnt = 0;
+  seg->frames = calloc (seg->page_cnt, sizeof *seg->frames);
+  if (seg->frames == NULL)
+    {
+      free (seg);
+      goto fail;
+    }
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < seg->page_cnt; i++)
+    if ((seg->frames[i] = frame_alloc_wired ()) == NULL)
+      break;
+  lock_release (&frame_lock);
+
+  if (i < seg->page_cnt || !attach (seg, addr))
+    {
+      segment_free (seg);
+      goto fail;
+    }
+  list_push_back (&segments, &seg->elem);
+  lock_release (&shm_lock);
+  return true;
+
+ fail:
+  lock_release (&shm_lock);
+  return false;
+}
+
+/* Attaches segment KEY to the current process at page-aligned
+   user address ADDR.  Returns the size of the segment in bytes,
+   or 0 if there is no such segment, ADDR is unsuitable, or memory
+   is exhausted. */
+size_t
+shm_map (int key, void *addr)
+{
+  struct segment *seg;
+  size_t size = 0;
+
+  lock_acquire (&shm_lock);
+  seg = lookup (key);
+  if (seg != NULL && attach (seg, addr))
+    size = seg->page_cnt * PGSIZE;
+  lock_release (&shm_lock);
+  return size;
+}
+
+/* Detaches the segment attached to the current process at ADDR.
+   Returns true if successful, false if no segment is attached
+   there. */
+bool
+shm_unmap (void *addr)
+{
+  struct list *shm = &thread_current ()->shm;
+  struct list_elem *e;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (shm); e != list_end (shm); e = list_next (e))
+    {
+      struct attachment *a = list_entry (e, struct attachment, elem);
+      if (a->base == addr)
+        {
+          detach (a);
+          lock_release (&shm_lock);
+          return true;
+        }
+    }
+  lock_release (&shm_lock);
+  return false;
+}
+
+/* Detaches every segment attached to the current process.  Called
+   on exit, before the supplemental page table is destroyed. */
+void
+shm_unmap_all (void)
+{
+  struct list *shm = &thread_current ()->shm;
+
+  lock_acquire (&shm_lock);
+  while (!list_empty (shm))
+    detach (list_entry (list_front (shm), struct attachment, elem));
+  lock_release (&shm_lock);
+}
+
+/* Returns the segment named KEY, or a null pointer if there is
+   none.  The caller must hold shm_lock. */
+static struct segment *
+lookup (int key)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct segment *seg = list_entry (e, struct segment, elem);
+      if (seg->key == key)
+        return seg;
+    }
+  return NULL;
+}
+
+/* Returns true if PAGE_CNT pages starting at ADDR are a
+   plausible place to attach a segment: ADDR is a nonnull,
+   page-aligned user address, and the pages keep clear of the
+   region the stack may grow into. */
+static bool
+valid_range (void *addr, size_t page_cnt)
+{
+  return (addr != NULL && pg_ofs (addr) == 0 && is_user_vaddr (addr)
+          && page_cnt + stack_page_limit <= pg_no (PHYS_BASE) - pg_no (addr));
+}
+
+/* Maps SEG into the current process at ADDR and records the
+   attachment.  Returns true if successful, false if ADDR is not
+   a valid_range(), any page would overlap an existing page, or
+   memory is exhausted.
+   The caller must hold shm_lock. */
+static bool
+attach (struct segment *seg, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct attachment *a;
+  size_t i;
+
+  if (!valid_range (addr, seg->page_cnt))
+    return false;
+
+  a = malloc (sizeof *a);
+  if (a == NULL)
+    return false;
+  for (i = 0; i < seg->page_cnt; i++)
+    if (!page_add_wired ((uint8_t *) addr + i * PGSIZE, seg->frames[i],
+                         true))
+      {
+        while (i-- > 0)
+          page_remove ((uint8_t *) addr + i * PGSIZE);
+        free (a);
+        return false;
+      }
+
+  a->seg = seg;
+  a->base = addr;
+  list_push_back (&t->shm, &a->elem);
+  seg->attach_cnt++;
+  return true;
+}
+
+/* Unmaps attachment A from the current process and frees it,
+   along with its segment if that was the segment's last
+   attachment.  The caller must hold shm_lock. */
+static void
+detach (struct attachment *a)
+{
+  struct segment *seg = a->seg;
+  size_t i;
+
+  for (i = 0; i < seg->page_cnt; i++)
+    page_remove ((uint8_t *) a->base + i * PGSIZE);
+  list_remove (&a->elem);
+  free (a);
+
+  if (--seg->attach_cnt == 0)
+    {
+      list_remove (&seg->elem);
+      segment_free (seg);
+    }
+}
+
+/* Drops SEG's references to its frames, freeing those no longer
+   mapped anywhere, and frees SEG.
+   The caller must hold shm_lock. */
+static void
+segment_free (struct segment *seg)
+{
+  size_t i;
+
+  lock_acquire (&frame_lock);
+  for (i = 0; i < seg->page_cnt; i++)
+    if (seg->frames[i] != NULL)
+      frame_release (seg->frames[i]);
+  lock_release (&frame_lock);
+  free (seg->frames);
+  free (seg);
+}
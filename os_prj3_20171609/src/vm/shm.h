@@ -0,0 +1,13 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+void shm_init (void);
+bool shm_new (int key, size_t size, void *addr);
+size_t shm_map (int key, void *addr);
+bool shm_unmap (void *addr);
+void shm_unmap_all (void);
+
+#endif /* vm/shm.h */
@@ -0,0 +1,87 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in one swap slot, which holds one page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;   /* Swap block device, or null. */
+static struct bitmap *swap_map;     /* Slots in use. */
+static struct lock swap_lock;       /* Protects swap_map. */
+
+/* Sets up swapping to the device in the BLOCK_SWAP role.
+   Without one, pages that must be swapped out cannot be evicted. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / PAGE_SECTORS;
+  else
+    printf ("swap: no swap device, swapping disabled\n");
+
+  swap_map = bitmap_create (slot_cnt);
+  if (swap_map == NULL)
+    PANIC ("swap: bitmap creation failed");
+}
+
+/* Allocates CNT contiguous swap slots and returns the first,
+   or SWAP_NONE if there is no such run of free slots.
+   Writing a cluster of pages to adjacent slots keeps both the
+   swap-out and a later read-around sequential on disk. */
+size_t
+swap_alloc (size_t cnt)
+{
+  size_t slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, cnt, false);
+  lock_release (&swap_lock);
+  return slot != BITMAP_ERROR ? slot : SWAP_NONE;
+}
+
+/* Writes the page at KPAGE to swap slot SLOT. */
+void
+swap_write (size_t slot, const void *kpage)
+{
+  size_t i;
+
+  ASSERT (slot != SWAP_NONE);
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_write (swap_device, slot * PAGE_SECTORS + i,
+                 (const uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads the page in swap slot SLOT into KPAGE.
+   The slot stays allocated. */
+void
+swap_read (size_t slot, void *kpage)
+{
+  size_t i;
+
+  ASSERT (slot != SWAP_NONE);
+
+  for (i = 0; i < PAGE_SECTORS; i++)
+    block_read (swap_device, slot * PAGE_SECTORS + i,
+                (uint8_t *) kpage + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Frees swap slot SLOT. */
+void
+swap_free (size_t slot)
+{
+  ASSERT (slot != SWAP_NONE);
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  lock_release (&swap_lock);
+}
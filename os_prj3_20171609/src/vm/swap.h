@@ -0,0 +1,18 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+/* Swap slot value meaning "not in swap". */
+#define SWAP_NONE ((size_t) -1)
+
+/* Maximum number of pages swapped out or in together. */
+#define SWAP_CLUSTER 8
+
+void swap_init (void);
+size_t swap_alloc (size_t cnt);
+void swap_write (size_t slot, const void *kpage);
+void swap_read (size_t slot, void *kpage);
+void swap_free (size_t slot);
+
+#endif /* vm/swap.h */